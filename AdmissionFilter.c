@@ -0,0 +1,158 @@
+#include "AdmissionFilter.h"
+
+#include <regex.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the "seen once" set is a bloom filter with this many bits
+#define BLOOM_BITS 0x100000
+#define BLOOM_HASH_COUNT 3
+// once this many words have been remembered, false positives start getting common,
+// so everything is forgotten and it starts over.
+#define BLOOM_MAX_WORDS (BLOOM_BITS / 8)
+// shorter strings of hex digits are too likely to be real words
+#define MIN_HEX_JUNK_LEN 8
+
+typedef struct {
+    uint8_t * bloom;
+    int bloom_words;
+    regex_t * patterns;
+    int patterns_len;
+    // regexec() needs a null-terminated copy of the word
+    char * scratch_word;
+    int scratch_word_capacity;
+} InternalAdmissionFilter;
+
+AdmissionFilter * AdmissionFilter_create()
+{
+    InternalAdmissionFilter * secret_data = (InternalAdmissionFilter *)malloc(sizeof(InternalAdmissionFilter));
+    secret_data->bloom = (uint8_t *)calloc(BLOOM_BITS / 8, 1);
+    secret_data->bloom_words = 0;
+    secret_data->patterns = NULL;
+    secret_data->patterns_len = 0;
+    secret_data->scratch_word = NULL;
+    secret_data->scratch_word_capacity = 0;
+
+    AdmissionFilter * filter = (AdmissionFilter *)malloc(sizeof(AdmissionFilter));
+    filter->_secret_data = secret_data;
+    return filter;
+}
+
+void AdmissionFilter_delete(AdmissionFilter * filter)
+{
+    InternalAdmissionFilter * secret_data = (InternalAdmissionFilter *)filter->_secret_data;
+    int i;
+    for (i = 0; i < secret_data->patterns_len; i++)
+        regfree(&secret_data->patterns[i]);
+    free(secret_data->patterns);
+    free(secret_data->scratch_word);
+    free(secret_data->bloom);
+    free(secret_data);
+    free(filter);
+}
+
+char AdmissionFilter_add_reject_pattern(AdmissionFilter * filter, const char * pattern)
+{
+    InternalAdmissionFilter * secret_data = (InternalAdmissionFilter *)filter->_secret_data;
+    regex_t regex;
+    if (regcomp(&regex, pattern, REG_EXTENDED | REG_NOSUB) != 0)
+        return 0;
+    secret_data->patterns = (regex_t *)realloc(secret_data->patterns, (secret_data->patterns_len + 1) * sizeof(regex_t));
+    secret_data->patterns[secret_data->patterns_len++] = regex;
+    return 1;
+}
+
+static char is_hex_digit(char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+// numbers, timestamps, ip addresses, hashes, uuids, and the like
+static char looks_like_junk(const char * word, int len)
+{
+    char has_letter = 0;
+    char has_digit = 0;
+    char is_hex = 1;
+    int i = 0;
+    if (len > 2 && word[0] == '0' && (word[1] == 'x' || word[1] == 'X'))
+        i = 2;
+    for (; i < len; i++) {
+        char c = word[i];
+        if (c >= '0' && c <= '9')
+            has_digit = 1;
+        else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+            has_letter = 1;
+        if (!is_hex_digit(c) && c != '-')
+            is_hex = 0;
+    }
+    if (!has_letter)
+        return 1;
+    return is_hex && has_digit && len >= MIN_HEX_JUNK_LEN;
+}
+
+static char matches_reject_pattern(InternalAdmissionFilter * secret_data, const char * word, int len)
+{
+    if (secret_data->patterns_len == 0)
+        return 0;
+    if (len + 1 > secret_data->scratch_word_capacity) {
+        secret_data->scratch_word_capacity = (len + 1) * 2;
+        secret_data->scratch_word = (char *)realloc(secret_data->scratch_word, secret_data->scratch_word_capacity);
+    }
+    memcpy(secret_data->scratch_word, word, len);
+    secret_data->scratch_word[len] = '\0';
+    int i;
+    for (i = 0; i < secret_data->patterns_len; i++)
+        if (regexec(&secret_data->patterns[i], secret_data->scratch_word, 0, NULL, 0) == 0)
+            return 1;
+    return 0;
+}
+
+// FNV-1a
+static uint64_t hash_word(const char * word, int len)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    int i;
+    for (i = 0; i < len; i++) {
+        hash ^= (unsigned char)word[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// remembers the word, and returns non-zero if it was already remembered.
+static char seen_before(InternalAdmissionFilter * secret_data, const char * word, int len)
+{
+    uint64_t hash = hash_word(word, len);
+    // derive the other hashes from the two halves of this one
+    uint32_t step = (uint32_t)(hash >> 32) | 1;
+    uint32_t bit_index = (uint32_t)hash;
+    char all_set = 1;
+    int i;
+    for (i = 0; i < BLOOM_HASH_COUNT; i++) {
+        uint32_t bit = bit_index % BLOOM_BITS;
+        uint8_t mask = 1 << (bit % 8);
+        if (!(secret_data->bloom[bit / 8] & mask)) {
+            all_set = 0;
+            secret_data->bloom[bit / 8] |= mask;
+        }
+        bit_index += step;
+    }
+    if (all_set)
+        return 1;
+    if (++secret_data->bloom_words >= BLOOM_MAX_WORDS) {
+        memset(secret_data->bloom, 0, BLOOM_BITS / 8);
+        secret_data->bloom_words = 0;
+    }
+    return 0;
+}
+
+char AdmissionFilter_admit(AdmissionFilter * filter, const char * word, int len)
+{
+    InternalAdmissionFilter * secret_data = (InternalAdmissionFilter *)filter->_secret_data;
+    if (looks_like_junk(word, len))
+        return 0;
+    if (matches_reject_pattern(secret_data, word, len))
+        return 0;
+    return seen_before(secret_data, word, len);
+}
@@ -0,0 +1,23 @@
+#ifndef _ADMISSION_FILTER_H_
+#define _ADMISSION_FILTER_H_
+
+// decides which words are worth putting in a HistoryDatabase.
+// most words in logs are one-off noise like numbers, hashes, and uuids.
+// those are rejected by rules, and any other word has to be seen twice before it gets in.
+
+typedef struct {
+    void * _secret_data;
+} AdmissionFilter;
+
+AdmissionFilter * AdmissionFilter_create();
+void AdmissionFilter_delete(AdmissionFilter * filter);
+
+// words matching this POSIX extended regular expression are always rejected.
+// returns 0 if the pattern doesn't compile.
+char AdmissionFilter_add_reject_pattern(AdmissionFilter * filter, const char * pattern);
+
+// returns non-zero if the word should be added.
+// this remembers the word, so it's not safe to call from more than one thread at once.
+char AdmissionFilter_admit(AdmissionFilter * filter, const char * word, int len);
+
+#endif
@@ -0,0 +1,66 @@
+#include "Arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_CHUNK_SIZE 0x10000
+#define MAX_CHUNK_SIZE 0x400000
+#define ALIGNMENT sizeof(void *)
+// the usable memory of a chunk starts right after the header
+#define CHUNK_HEADER_SIZE ((sizeof(Arena_Chunk) + ALIGNMENT - 1) & ~(ALIGNMENT - 1))
+
+Arena * Arena_create()
+{
+    Arena * arena = (Arena *)malloc(sizeof(Arena));
+    arena->chunks = NULL;
+    arena->size = 0;
+    return arena;
+}
+
+void Arena_delete(Arena * arena)
+{
+    Arena_Chunk * chunk = arena->chunks;
+    while (chunk != NULL) {
+        Arena_Chunk * next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(arena);
+}
+
+void * Arena_alloc(Arena * arena, size_t size)
+{
+    size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    Arena_Chunk * chunk = arena->chunks;
+    if (chunk == NULL || chunk->size - chunk->used < size) {
+        // grow chunk sizes along with the arena, so big arenas don't have lots of chunks
+        size_t chunk_size = arena->size < MIN_CHUNK_SIZE ? MIN_CHUNK_SIZE : arena->size;
+        if (chunk_size > MAX_CHUNK_SIZE)
+            chunk_size = MAX_CHUNK_SIZE;
+        if (chunk_size < size)
+            chunk_size = size;
+        chunk = (Arena_Chunk *)malloc(CHUNK_HEADER_SIZE + chunk_size);
+        chunk->size = chunk_size;
+        chunk->used = 0;
+        if (arena->chunks != NULL && arena->chunks->size - arena->chunks->used > chunk_size - size) {
+            // an oversized allocation. keep using the current chunk for small things.
+            chunk->next = arena->chunks->next;
+            arena->chunks->next = chunk;
+        } else {
+            chunk->next = arena->chunks;
+            arena->chunks = chunk;
+        }
+        arena->size += chunk_size;
+    }
+    void * result = (char *)chunk + CHUNK_HEADER_SIZE + chunk->used;
+    chunk->used += size;
+    return result;
+}
+
+char * Arena_strndup(Arena * arena, const char * string, size_t len)
+{
+    char * result = (char *)Arena_alloc(arena, len + 1);
+    memcpy(result, string, len);
+    result[len] = '\0';
+    return result;
+}
@@ -0,0 +1,29 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stddef.h>
+
+// a region allocator. allocations are carved out of big chunks and are never
+// freed individually. deleting the arena frees everything at once.
+
+typedef struct Arena_Chunk_ {
+    struct Arena_Chunk_ * next;
+    size_t size;
+    size_t used;
+} Arena_Chunk;
+
+typedef struct {
+    Arena_Chunk * chunks;
+    // total bytes of all the chunks
+    size_t size;
+} Arena;
+
+Arena * Arena_create();
+void Arena_delete(Arena * arena);
+
+// the result is aligned for any pointer or integer type.
+void * Arena_alloc(Arena * arena, size_t size);
+// copies len bytes and adds a null terminator.
+char * Arena_strndup(Arena * arena, const char * string, size_t len);
+
+#endif
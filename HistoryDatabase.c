@@ -1,100 +1,366 @@
 #include "HistoryDatabase.h"
 
-#include "RbTree.h"
+#include "RadixTree.h"
+#include "Arena.h"
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
+#include <stdint.h>
 #include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 typedef struct {
     int access_count;
     char is_case_senssitive;
-    RbTree * tree;
+    RadixTree * tree;
+    // the words and their text live here, except text that's in the mapped file.
+    Arena * pool;
+    // where lower case keys are made when looking up words.
+    char * scratch_key;
+    int scratch_key_capacity;
+    // 0 means no limit
+    int max_words;
+    size_t max_bytes;
+    // how many words were left after the last time words were evicted to save memory.
+    int word_count_after_eviction;
+
+    // everything below is only used when the database is saved in a file.
+    // path is NULL otherwise.
+    char * path;
+    // the words loaded at startup point into this mapping of the file.
+    char * mapped_file;
+    size_t mapped_file_size;
+    // how big the file was the last time we looked. decides when to compact.
+    size_t file_size;
+    // hits since the last sync are counted per word, and appended to the log file by the next sync.
+    // these are the words with unsynced hits.
+    struct WordData ** unsynced_words;
+    int unsynced_words_len;
+    int unsynced_words_capacity;
+    int log_fd;
+    char * log_buffer;
+    int log_buffer_len;
+    int log_buffer_capacity;
 } InternalHistoryDatabase;
 
-typedef struct {
+typedef struct WordData {
     char * text;
+    // same as text if it's already in the right case
+    char * key;
+    int len;
     int hit_count;
     int last_hit_time;
+    // how many of the hits haven't been written to the log yet
+    int unsynced_hit_count;
 } WordData;
 
-static int strcmp_with_casting(void * left, void * right)
+static InternalHistoryDatabase * create_internal(char is_case_senssitive)
 {
-    return strcmp((const char *)left, (const char *)right);
+    InternalHistoryDatabase * secret_data = (InternalHistoryDatabase *)malloc(sizeof(InternalHistoryDatabase));
+    secret_data->access_count = 0;
+    secret_data->is_case_senssitive = is_case_senssitive;
+    secret_data->tree = RadixTree_create();
+    secret_data->pool = Arena_create();
+    secret_data->scratch_key = NULL;
+    secret_data->scratch_key_capacity = 0;
+    secret_data->max_words = 0;
+    secret_data->max_bytes = 0;
+    secret_data->word_count_after_eviction = 0;
+    secret_data->path = NULL;
+    secret_data->mapped_file = NULL;
+    secret_data->mapped_file_size = 0;
+    secret_data->file_size = 0;
+    secret_data->unsynced_words = NULL;
+    secret_data->unsynced_words_len = 0;
+    secret_data->unsynced_words_capacity = 0;
+    secret_data->log_fd = -1;
+    secret_data->log_buffer = NULL;
+    secret_data->log_buffer_len = 0;
+    secret_data->log_buffer_capacity = 0;
+    return secret_data;
 }
 
 HistoryDatabase * HistoryDatabase_create(char is_case_senssitive)
 {
     HistoryDatabase * database = (HistoryDatabase *)malloc(sizeof(HistoryDatabase));
-    InternalHistoryDatabase * secret_data = (InternalHistoryDatabase *)malloc(sizeof(InternalHistoryDatabase));
-    secret_data->access_count = 0;
-    secret_data->is_case_senssitive = is_case_senssitive;
-    secret_data->tree = RbTree_create(strcmp_with_casting);
-    database->_secret_data = secret_data;
+    database->_secret_data = create_internal(is_case_senssitive);
     return database;
 }
 
-static char delete_visitor(RbTree_Node * node, void * data)
+static void delete_internal(InternalHistoryDatabase * secret_data)
 {
-    free(node->key);
-    WordData * word_data = (WordData *)node->value;
-    free(word_data->text);
-    free(word_data);
-    return 1;
+    RadixTree_delete(secret_data->tree, NULL);
+    Arena_delete(secret_data->pool);
+    if (secret_data->mapped_file != NULL)
+        munmap(secret_data->mapped_file, secret_data->mapped_file_size);
+    if (secret_data->log_fd != -1)
+        close(secret_data->log_fd);
+    free(secret_data->scratch_key);
+    free(secret_data->unsynced_words);
+    free(secret_data->log_buffer);
+    free(secret_data->path);
+    free(secret_data);
 }
+static void compact_if_log_is_big(InternalHistoryDatabase * secret_data);
 void HistoryDatabase_delete(HistoryDatabase * database)
 {
     InternalHistoryDatabase * secret_data = (InternalHistoryDatabase *)database->_secret_data;
-    RbTree_delete(secret_data->tree, delete_visitor);
-    free(secret_data);
+    HistoryDatabase_sync(database);
+    if (secret_data->path != NULL)
+        compact_if_log_is_big(secret_data);
+    delete_internal(secret_data);
     free(database);
 }
 
-static char * key_for_word(char is_case_senssitive, char * word)
+static int compare_negative_popularity(WordData * left, WordData * right)
+{
+    int hit_count_difference = left->hit_count - right->hit_count;
+    if (hit_count_difference != 0)
+        return -hit_count_difference;
+    return -(left->last_hit_time - right->last_hit_time);
+}
+static int qsort_compare_negative_popularity(const void * left, const void * right)
+{
+    return compare_negative_popularity(*(WordData **)left, *(WordData **)right);
+}
+
+static char is_in_mapped_file(InternalHistoryDatabase * secret_data, char * pointer)
+{
+    return secret_data->mapped_file != NULL &&
+        pointer >= secret_data->mapped_file &&
+        pointer < secret_data->mapped_file + secret_data->mapped_file_size;
+}
+
+static char collect_visitor(void * value, void * data)
+{
+    WordData *** cursor = (WordData ***)data;
+    *((*cursor)++) = (WordData *)value;
+    return 1;
+}
+// returns all the words in no particular order. free the array when you're done with it.
+static WordData ** collect_words(InternalHistoryDatabase * secret_data)
+{
+    WordData ** words = (WordData **)malloc(secret_data->tree->size * sizeof(WordData *));
+    WordData ** cursor = words;
+    RadixTree_traverse_prefix(secret_data->tree, "", 0, collect_visitor, &cursor);
+    return words;
+}
+
+static void mark_unsynced(InternalHistoryDatabase * secret_data, WordData * word_data)
+{
+    if (secret_data->unsynced_words_len == secret_data->unsynced_words_capacity) {
+        secret_data->unsynced_words_capacity = secret_data->unsynced_words_capacity == 0 ? 0x100 : secret_data->unsynced_words_capacity * 2;
+        secret_data->unsynced_words = (WordData **)realloc(secret_data->unsynced_words, secret_data->unsynced_words_capacity * sizeof(WordData *));
+    }
+    secret_data->unsynced_words[secret_data->unsynced_words_len++] = word_data;
+}
+
+static size_t memory_used(InternalHistoryDatabase * secret_data)
+{
+    return secret_data->pool->size + secret_data->tree->arena->size;
+}
+
+// forgets all but the keep_count most popular words.
+// the survivors are copied into a new tree and pool, so that the memory is really freed.
+// their hit counts are halved, so that words that were popular long ago can make room for new ones.
+static void evict(InternalHistoryDatabase * secret_data, int keep_count)
+{
+    int word_count = secret_data->tree->size;
+    WordData ** words = collect_words(secret_data);
+    qsort(words, word_count, sizeof(WordData *), qsort_compare_negative_popularity);
+    RadixTree * tree = RadixTree_create();
+    Arena * pool = Arena_create();
+    // the unsynced words move too. the hits of forgotten words are forgotten with them.
+    secret_data->unsynced_words_len = 0;
+    int i;
+    for (i = 0; i < keep_count && i < word_count; i++) {
+        WordData * old_word_data = words[i];
+        WordData * word_data = (WordData *)Arena_alloc(pool, sizeof(WordData));
+        *word_data = *old_word_data;
+        word_data->hit_count = (word_data->hit_count + 1) / 2;
+        if (!is_in_mapped_file(secret_data, old_word_data->text))
+            word_data->text = Arena_strndup(pool, old_word_data->text, old_word_data->len);
+        if (old_word_data->key == old_word_data->text)
+            word_data->key = word_data->text;
+        else if (!is_in_mapped_file(secret_data, old_word_data->key))
+            word_data->key = Arena_strndup(pool, old_word_data->key, old_word_data->len);
+        RadixTree_put(tree, word_data->key, word_data->len, word_data);
+        if (word_data->unsynced_hit_count > 0)
+            mark_unsynced(secret_data, word_data);
+    }
+    free(words);
+    RadixTree_delete(secret_data->tree, NULL);
+    Arena_delete(secret_data->pool);
+    secret_data->tree = tree;
+    secret_data->pool = pool;
+}
+
+// call this after adding new words.
+static void enforce_limits(InternalHistoryDatabase * secret_data)
+{
+    int word_count = secret_data->tree->size;
+    // evict a tenth more than necessary, so that this doesn't happen again right away.
+    if (secret_data->max_words > 0 && word_count > secret_data->max_words) {
+        int keep_count = secret_data->max_words - secret_data->max_words / 10;
+        if (keep_count == secret_data->max_words && keep_count > 1)
+            keep_count--;
+        evict(secret_data, keep_count);
+        return;
+    }
+    if (secret_data->max_bytes > 0 && memory_used(secret_data) > secret_data->max_bytes) {
+        // if evicting didn't help enough last time, let some words accumulate before trying again.
+        int min_word_count = secret_data->word_count_after_eviction + secret_data->word_count_after_eviction / 16;
+        if (word_count <= min_word_count)
+            return;
+        size_t bytes_per_word = memory_used(secret_data) / word_count + 1;
+        evict(secret_data, secret_data->max_bytes / 10 * 9 / bytes_per_word);
+        secret_data->word_count_after_eviction = secret_data->tree->size;
+    }
+}
+
+// returns the word itself if it's already in the right case.
+// otherwise returns a lower case copy, which is only good until the next call.
+static const char * key_for_word(InternalHistoryDatabase * secret_data, const char * word, int len)
 {
-    if (is_case_senssitive)
+    if (secret_data->is_case_senssitive)
         return word;
-    // to lower case
-    char * key = strdup(word);
     int i;
-    for (i = 0; key[i] != '\0'; i++)
-        key[i] = tolower(key[i]);
+    for (i = 0; i < len; i++)
+        if (word[i] != tolower((unsigned char)word[i]))
+            break;
+    if (i == len)
+        return word;
+    // to lower case
+    if (len + 1 > secret_data->scratch_key_capacity) {
+        secret_data->scratch_key_capacity = (len + 1) * 2;
+        secret_data->scratch_key = (char *)realloc(secret_data->scratch_key, secret_data->scratch_key_capacity);
+    }
+    char * key = secret_data->scratch_key;
+    memcpy(key, word, i);
+    for (; i < len; i++)
+        key[i] = tolower((unsigned char)word[i]);
+    key[len] = '\0';
     return key;
 }
 
-void HistoryDatabase_add(HistoryDatabase * database, char * word)
+// the hits are unsynced if the database is saved in a file.
+static void add_word(InternalHistoryDatabase * secret_data, const char * word, int len, int hit_count)
 {
-    InternalHistoryDatabase * secret_data = (InternalHistoryDatabase *)database->_secret_data;
-    char * key = key_for_word(secret_data->is_case_senssitive, word);
-    WordData * word_data = (WordData *)RbTree_get(secret_data->tree, key);
-    if (word_data == NULL) {
-        word_data = (WordData *)malloc(sizeof(WordData));
-        word_data->text = strdup(word);
+    const char * key = key_for_word(secret_data, word, len);
+    WordData * word_data = (WordData *)RadixTree_get(secret_data->tree, key, len);
+    char is_new = word_data == NULL;
+    if (is_new) {
+        word_data = (WordData *)Arena_alloc(secret_data->pool, sizeof(WordData));
+        word_data->text = Arena_strndup(secret_data->pool, word, len);
+        // the tree keeps pointing at the key, so it has to be in the pool too
+        word_data->key = key == word ? word_data->text : Arena_strndup(secret_data->pool, key, len);
+        word_data->len = len;
         word_data->hit_count = 0;
-        RbTree_put(secret_data->tree, strdup(key), word_data);
+        word_data->unsynced_hit_count = 0;
+        RadixTree_put(secret_data->tree, word_data->key, len, word_data);
     }
-    word_data->hit_count++;
+    word_data->hit_count += hit_count;
     word_data->last_hit_time = secret_data->access_count++;
-    if (key != word)
-        free(key);
+    if (secret_data->path != NULL) {
+        if (word_data->unsynced_hit_count == 0)
+            mark_unsynced(secret_data, word_data);
+        word_data->unsynced_hit_count += hit_count;
+    }
+    // this might forget the new word right away, so don't use word_data after this.
+    if (is_new)
+        enforce_limits(secret_data);
+}
+
+static void append_to_log(InternalHistoryDatabase * secret_data, const char * word, uint32_t word_len, int32_t hit_count)
+{
+    // each record is the length, then the number of hits, then the word
+    int record_len = sizeof(word_len) + sizeof(hit_count) + word_len;
+    if (secret_data->log_buffer_len + record_len > secret_data->log_buffer_capacity) {
+        secret_data->log_buffer_capacity = (secret_data->log_buffer_len + record_len) * 2;
+        secret_data->log_buffer = (char *)realloc(secret_data->log_buffer, secret_data->log_buffer_capacity);
+    }
+    char * record = secret_data->log_buffer + secret_data->log_buffer_len;
+    memcpy(record, &word_len, sizeof(word_len));
+    memcpy(record + sizeof(word_len), &hit_count, sizeof(hit_count));
+    memcpy(record + sizeof(word_len) + sizeof(hit_count), word, word_len);
+    secret_data->log_buffer_len += record_len;
+}
+
+void HistoryDatabase_add(HistoryDatabase * database, char * word)
+{
+    HistoryDatabase_add_n(database, word, strlen(word));
+}
+
+void HistoryDatabase_add_n(HistoryDatabase * database, const char * word, size_t len)
+{
+    InternalHistoryDatabase * secret_data = (InternalHistoryDatabase *)database->_secret_data;
+    add_word(secret_data, word, len, 1);
+}
+
+char HistoryDatabase_contains(HistoryDatabase * database, const char * word, size_t len)
+{
+    InternalHistoryDatabase * secret_data = (InternalHistoryDatabase *)database->_secret_data;
+    const char * key = key_for_word(secret_data, word, len);
+    return RadixTree_get(secret_data->tree, key, len) != NULL;
 }
 
 typedef struct {
-    char * prefix;
-    int prefix_len;
+    // -1 means no limit
+    int max_matches;
     int matches_cap;
+    // once max_matches is reached, this is a heap with the least popular match on top.
     WordData ** matches;
     int matches_len;
+    // all the matches, including the ones that didn't make it
+    int match_count;
 } MatchCollect;
 
-static char match_visitor(RbTree_Node * node, void * data)
+static void heap_sift_down(WordData ** heap, int heap_len, int index)
+{
+    while (1) {
+        int least_popular = index;
+        int left = 2 * index + 1;
+        int right = left + 1;
+        if (left < heap_len && compare_negative_popularity(heap[left], heap[least_popular]) > 0)
+            least_popular = left;
+        if (right < heap_len && compare_negative_popularity(heap[right], heap[least_popular]) > 0)
+            least_popular = right;
+        if (least_popular == index)
+            return;
+        WordData * tmp = heap[index];
+        heap[index] = heap[least_popular];
+        heap[least_popular] = tmp;
+        index = least_popular;
+    }
+}
+
+static char match_visitor(void * value, void * data)
 {
     MatchCollect * match_collector = (MatchCollect *)data;
-    if (strncmp(match_collector->prefix, (char *)node->key, match_collector->prefix_len) != 0)
-        return 0;
-    // it's a match
-    WordData * word_data = (WordData *)node->value;
+    WordData * word_data = (WordData *)value;
+    match_collector->match_count++;
+    // only counting
+    if (match_collector->max_matches == 0)
+        return 1;
+    if (match_collector->matches_len == match_collector->max_matches) {
+        // replace the least popular match if this one is better
+        if (compare_negative_popularity(word_data, match_collector->matches[0]) < 0) {
+            match_collector->matches[0] = word_data;
+            heap_sift_down(match_collector->matches, match_collector->matches_len, 0);
+        }
+        return 1;
+    }
     match_collector->matches[match_collector->matches_len++] = word_data;
-    if (match_collector->matches_len >= match_collector->matches_cap) {
+    if (match_collector->matches_len == match_collector->max_matches) {
+        // full. from now on, keep only the best ones.
+        int i;
+        for (i = match_collector->matches_len / 2 - 1; i >= 0; i--)
+            heap_sift_down(match_collector->matches, match_collector->matches_len, i);
+    } else if (match_collector->matches_len >= match_collector->matches_cap) {
         // expand capacity
         match_collector->matches_cap *= 2;
         match_collector->matches = (WordData **)realloc(match_collector->matches, match_collector->matches_cap * sizeof(WordData *));
@@ -102,48 +368,30 @@ static char match_visitor(RbTree_Node * node, void * data)
     return 1;
 }
 
-static int compare_negative_popularity(WordData * left, WordData * right)
-{
-    int hit_count_difference = left->hit_count - right->hit_count;
-    if (hit_count_difference != 0)
-        return -hit_count_difference;
-    return -(left->last_hit_time - right->last_hit_time);
-}
-char ** HistoryDatabase_prefix_matches(HistoryDatabase * database, char * prefix)
+static char ** collect_prefix_matches(HistoryDatabase * database, char * prefix, int max_matches, int * match_count)
 {
     WordData ** matches;
     int matches_len;
     // collect the prefix matches
     {
         InternalHistoryDatabase * secret_data = (InternalHistoryDatabase *)database->_secret_data;
-        char * key_prefix = key_for_word(secret_data->is_case_senssitive, prefix);
+        int prefix_len = strlen(prefix);
+        const char * key_prefix = key_for_word(secret_data, prefix, prefix_len);
         MatchCollect match_collector;
-        match_collector.prefix = key_prefix;
-        match_collector.prefix_len = strlen(key_prefix);
-        match_collector.matches_cap = 0x10;
+        match_collector.max_matches = max_matches;
+        match_collector.matches_cap = max_matches >= 0 && max_matches < 0x10 ? max_matches + 1 : 0x10;
         match_collector.matches = (WordData **)malloc(match_collector.matches_cap * sizeof(WordData *));
         match_collector.matches_len = 0;
-        RbTree_traverse_starting_at(secret_data->tree, key_prefix, match_visitor, &match_collector);
-        if (key_prefix != prefix)
-            free(key_prefix);
+        match_collector.match_count = 0;
+        if (max_matches != 0 || match_count != NULL)
+            RadixTree_traverse_prefix(secret_data->tree, key_prefix, prefix_len, match_visitor, &match_collector);
         matches = match_collector.matches;
         matches_len = match_collector.matches_len;
+        if (match_count != NULL)
+            *match_count = match_collector.match_count;
     }
     // sort results by most popular
-    {
-        // insertion sort
-        int i;
-        for (i = 1; i < matches_len; i++) {
-            WordData * insert_this = matches[i];
-            int j;
-            for (j = i - 1; j >= 0; j--) {
-                if (compare_negative_popularity(matches[j], insert_this) < 0)
-                    break;
-                matches[j + 1] = matches[j];
-            }
-            matches[j + 1] = insert_this;
-        }
-    }
+    qsort(matches, matches_len, sizeof(WordData *), qsort_compare_negative_popularity);
     // return just the strings
     {
         char ** results = (char **)malloc((matches_len + 1) * sizeof(char *));
@@ -151,7 +399,322 @@ char ** HistoryDatabase_prefix_matches(HistoryDatabase * database, char * prefix
         for (i = 0; i < matches_len; i++)
             results[i] = strdup(matches[i]->text);
         results[matches_len] = NULL;
+        free(matches);
         return results;
     }
 }
 
+char ** HistoryDatabase_prefix_matches(HistoryDatabase * database, char * prefix)
+{
+    return collect_prefix_matches(database, prefix, -1, NULL);
+}
+
+char ** HistoryDatabase_prefix_top_k(HistoryDatabase * database, char * prefix, int k, int * match_count)
+{
+    return collect_prefix_matches(database, prefix, k, match_count);
+}
+
+int HistoryDatabase_common_prefix_len(HistoryDatabase * database, char * prefix)
+{
+    InternalHistoryDatabase * secret_data = (InternalHistoryDatabase *)database->_secret_data;
+    int prefix_len = strlen(prefix);
+    const char * key_prefix = key_for_word(secret_data, prefix, prefix_len);
+    return RadixTree_common_prefix_len(secret_data->tree, key_prefix, prefix_len);
+}
+
+// the file is a header, then an array of FileWord, then the text of the words.
+// every string is null terminated, so words can point right into the mapped file.
+#define FILE_MAGIC "conshist"
+#define FILE_VERSION 1
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t is_case_senssitive;
+    uint32_t word_count;
+    int32_t access_count;
+} FileHeader;
+typedef struct {
+    uint64_t text_offset;
+    // same as text_offset if the file is case sensitive
+    uint64_t key_offset;
+    uint32_t text_len;
+    int32_t hit_count;
+    int32_t last_hit_time;
+    uint32_t unused;
+} FileWord;
+
+// when the database is deleted, the log gets folded into the file if it's at least this big
+// and at least half the size of the file.
+#define MIN_LOG_SIZE_TO_COMPACT 0x40000
+
+static char file_string_is_valid(char * file, size_t file_size, uint64_t offset, uint32_t len)
+{
+    return offset < file_size && len < file_size - offset && file[offset + len] == '\0';
+}
+
+// loads the words from the file at path. does nothing if the file doesn't exist or looks wrong.
+static void load_file(InternalHistoryDatabase * secret_data, const char * path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return;
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == -1 || file_stat.st_size < sizeof(FileHeader)) {
+        close(fd);
+        return;
+    }
+    size_t file_size = file_stat.st_size;
+    char * file = (char *)mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED)
+        return;
+    FileHeader * header = (FileHeader *)file;
+    if (memcmp(header->magic, FILE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != FILE_VERSION ||
+        header->word_count > (file_size - sizeof(FileHeader)) / sizeof(FileWord))
+    {
+        munmap(file, file_size);
+        return;
+    }
+    secret_data->mapped_file = file;
+    secret_data->mapped_file_size = file_size;
+    secret_data->file_size = file_size;
+    secret_data->access_count = header->access_count;
+    char keys_match = (header->is_case_senssitive != 0) == (secret_data->is_case_senssitive != 0);
+    FileWord * file_words = (FileWord *)(file + sizeof(FileHeader));
+    uint32_t i;
+    for (i = 0; i < header->word_count; i++) {
+        FileWord * file_word = &file_words[i];
+        if (!file_string_is_valid(file, file_size, file_word->text_offset, file_word->text_len) ||
+            !file_string_is_valid(file, file_size, file_word->key_offset, file_word->text_len))
+            continue;
+        char * text = file + file_word->text_offset;
+        const char * key = keys_match ? file + file_word->key_offset : key_for_word(secret_data, text, file_word->text_len);
+        WordData * word_data = (WordData *)RadixTree_get(secret_data->tree, key, file_word->text_len);
+        if (word_data != NULL) {
+            // only possible when the file's case sensitivity is different.
+            word_data->hit_count += file_word->hit_count;
+            if (file_word->last_hit_time > word_data->last_hit_time)
+                word_data->last_hit_time = file_word->last_hit_time;
+            continue;
+        }
+        if (key == secret_data->scratch_key)
+            key = Arena_strndup(secret_data->pool, key, file_word->text_len);
+        word_data = (WordData *)Arena_alloc(secret_data->pool, sizeof(WordData));
+        word_data->text = text;
+        word_data->key = (char *)key;
+        word_data->len = file_word->text_len;
+        word_data->hit_count = file_word->hit_count;
+        word_data->last_hit_time = file_word->last_hit_time;
+        word_data->unsynced_hit_count = 0;
+        RadixTree_put(secret_data->tree, key, file_word->text_len, word_data);
+    }
+    enforce_limits(secret_data);
+}
+
+// adds the hits of every word in the log again.
+static void replay_log(InternalHistoryDatabase * secret_data, int log_fd)
+{
+    struct stat log_stat;
+    if (fstat(log_fd, &log_stat) == -1 || log_stat.st_size == 0)
+        return;
+    size_t log_size = log_stat.st_size;
+    char * log = (char *)mmap(NULL, log_size, PROT_READ, MAP_PRIVATE, log_fd, 0);
+    if (log == MAP_FAILED)
+        return;
+    size_t position = 0;
+    // a record that got cut off at the end is ignored
+    while (log_size - position >= sizeof(uint32_t) + sizeof(int32_t)) {
+        uint32_t word_len;
+        int32_t hit_count;
+        memcpy(&word_len, log + position, sizeof(word_len));
+        memcpy(&hit_count, log + position + sizeof(word_len), sizeof(hit_count));
+        position += sizeof(word_len) + sizeof(hit_count);
+        if (word_len > log_size - position)
+            break;
+        if (hit_count > 0)
+            add_word(secret_data, log + position, word_len, hit_count);
+        position += word_len;
+    }
+    munmap(log, log_size);
+}
+
+// returns non-zero on success
+static char save_file(InternalHistoryDatabase * secret_data, const char * path)
+{
+    int word_count = secret_data->tree->size;
+    WordData ** words = collect_words(secret_data);
+
+    // write to a temporary file, then atomically replace the real one.
+    int temp_path_len = strlen(path) + 32;
+    char * temp_path = (char *)malloc(temp_path_len);
+    snprintf(temp_path, temp_path_len, "%s.%d.tmp", path, (int)getpid());
+    FILE * file = fopen(temp_path, "wb");
+    char success = file != NULL;
+    if (success) {
+        fchmod(fileno(file), S_IRUSR | S_IWUSR);
+        FileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+        header.version = FILE_VERSION;
+        header.is_case_senssitive = secret_data->is_case_senssitive;
+        header.word_count = word_count;
+        header.access_count = secret_data->access_count;
+        fwrite(&header, sizeof(header), 1, file);
+        uint64_t text_offset = sizeof(FileHeader) + (uint64_t)word_count * sizeof(FileWord);
+        int i;
+        for (i = 0; i < word_count; i++) {
+            FileWord file_word;
+            memset(&file_word, 0, sizeof(file_word));
+            file_word.text_len = words[i]->len;
+            file_word.text_offset = text_offset;
+            text_offset += file_word.text_len + 1;
+            if (words[i]->key != words[i]->text) {
+                file_word.key_offset = text_offset;
+                text_offset += file_word.text_len + 1;
+            } else {
+                file_word.key_offset = file_word.text_offset;
+            }
+            file_word.hit_count = words[i]->hit_count;
+            file_word.last_hit_time = words[i]->last_hit_time;
+            fwrite(&file_word, sizeof(file_word), 1, file);
+        }
+        for (i = 0; i < word_count; i++) {
+            fwrite(words[i]->text, words[i]->len + 1, 1, file);
+            if (words[i]->key != words[i]->text)
+                fwrite(words[i]->key, words[i]->len + 1, 1, file);
+        }
+        success = !ferror(file);
+        if (fclose(file) != 0)
+            success = 0;
+        if (success)
+            success = rename(temp_path, path) == 0;
+        if (!success)
+            unlink(temp_path);
+    }
+    free(temp_path);
+    free(words);
+    return success;
+}
+
+// folds the log into the file. the caller must hold the lock on the log.
+// this goes by what's on disk rather than what's in memory, because other
+// processes using the same file have been appending to the log too.
+static void compact(InternalHistoryDatabase * secret_data)
+{
+    InternalHistoryDatabase * merged = create_internal(secret_data->is_case_senssitive);
+    // the file shouldn't grow without bounds either
+    merged->max_words = secret_data->max_words;
+    merged->max_bytes = secret_data->max_bytes;
+    load_file(merged, secret_data->path);
+    replay_log(merged, secret_data->log_fd);
+    if (save_file(merged, secret_data->path)) {
+        ftruncate(secret_data->log_fd, 0);
+        struct stat file_stat;
+        if (stat(secret_data->path, &file_stat) == 0)
+            secret_data->file_size = file_stat.st_size;
+    }
+    delete_internal(merged);
+}
+
+HistoryDatabase * HistoryDatabase_open(const char * path, char is_case_senssitive)
+{
+    int log_path_len = strlen(path) + 5;
+    char * log_path = (char *)malloc(log_path_len);
+    snprintf(log_path, log_path_len, "%s.log", path);
+    int log_fd = open(log_path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    free(log_path);
+    if (log_fd == -1)
+        return NULL;
+
+    InternalHistoryDatabase * secret_data = create_internal(is_case_senssitive);
+    flock(log_fd, LOCK_SH);
+    load_file(secret_data, path);
+    replay_log(secret_data, log_fd);
+    flock(log_fd, LOCK_UN);
+    secret_data->path = strdup(path);
+    secret_data->log_fd = log_fd;
+
+    HistoryDatabase * database = (HistoryDatabase *)malloc(sizeof(HistoryDatabase));
+    database->_secret_data = secret_data;
+    return database;
+}
+
+static void compact_if_log_is_big(InternalHistoryDatabase * secret_data)
+{
+    flock(secret_data->log_fd, LOCK_EX);
+    struct stat log_stat;
+    if (fstat(secret_data->log_fd, &log_stat) == 0 &&
+        log_stat.st_size >= MIN_LOG_SIZE_TO_COMPACT &&
+        log_stat.st_size > secret_data->file_size / 2)
+    {
+        compact(secret_data);
+    }
+    flock(secret_data->log_fd, LOCK_UN);
+}
+
+void HistoryDatabase_prepare_sync(HistoryDatabase * database)
+{
+    InternalHistoryDatabase * secret_data = (InternalHistoryDatabase *)database->_secret_data;
+    if (secret_data->path == NULL)
+        return;
+    int i;
+    for (i = 0; i < secret_data->unsynced_words_len; i++) {
+        WordData * word_data = secret_data->unsynced_words[i];
+        append_to_log(secret_data, word_data->text, word_data->len, word_data->unsynced_hit_count);
+        word_data->unsynced_hit_count = 0;
+    }
+    secret_data->unsynced_words_len = 0;
+}
+
+void HistoryDatabase_write_log(HistoryDatabase * database)
+{
+    InternalHistoryDatabase * secret_data = (InternalHistoryDatabase *)database->_secret_data;
+    if (secret_data->path == NULL || secret_data->log_buffer_len == 0)
+        return;
+    flock(secret_data->log_fd, LOCK_EX);
+    char * remaining = secret_data->log_buffer;
+    int remaining_len = secret_data->log_buffer_len;
+    while (remaining_len > 0) {
+        ssize_t written = write(secret_data->log_fd, remaining, remaining_len);
+        if (written < 0)
+            break;
+        remaining += written;
+        remaining_len -= written;
+    }
+    secret_data->log_buffer_len = 0;
+    flock(secret_data->log_fd, LOCK_UN);
+}
+
+void HistoryDatabase_sync(HistoryDatabase * database)
+{
+    HistoryDatabase_prepare_sync(database);
+    HistoryDatabase_write_log(database);
+}
+
+void HistoryDatabase_set_max_words(HistoryDatabase * database, int max_words)
+{
+    InternalHistoryDatabase * secret_data = (InternalHistoryDatabase *)database->_secret_data;
+    secret_data->max_words = max_words;
+    enforce_limits(secret_data);
+}
+
+void HistoryDatabase_set_max_bytes(HistoryDatabase * database, size_t max_bytes)
+{
+    InternalHistoryDatabase * secret_data = (InternalHistoryDatabase *)database->_secret_data;
+    secret_data->max_bytes = max_bytes;
+    secret_data->word_count_after_eviction = 0;
+    enforce_limits(secret_data);
+}
+
+int HistoryDatabase_get_word_count(HistoryDatabase * database)
+{
+    InternalHistoryDatabase * secret_data = (InternalHistoryDatabase *)database->_secret_data;
+    return secret_data->tree->size;
+}
+
+size_t HistoryDatabase_get_memory_used(HistoryDatabase * database)
+{
+    InternalHistoryDatabase * secret_data = (InternalHistoryDatabase *)database->_secret_data;
+    return memory_used(secret_data);
+}
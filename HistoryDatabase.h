@@ -1,13 +1,54 @@
 #ifndef _HISTORY_DATABASE_H_
 #define _HISTORY_DATABASE_H_
 
+#include <stddef.h>
+
 typedef struct {
     void * _secret_data;
 } HistoryDatabase;
 
 HistoryDatabase * HistoryDatabase_create(char is_case_senssitive);
+// like HistoryDatabase_create, but the words are loaded from the file at path,
+// and words added later are saved to it. several processes can use the same file.
+// new hits go to a log next to the file (path + ".log"), which is folded into the file when the
+// database is deleted, if the log has gotten big.
+// returns NULL if the log can't be opened for writing.
+HistoryDatabase * HistoryDatabase_open(const char * path, char is_case_senssitive);
+// writes the hits since the last sync to the log. each word only takes one record, however many hits it got.
+void HistoryDatabase_sync(HistoryDatabase * database);
+// HistoryDatabase_sync in two steps. the first one is quick. the second one waits for the log's file lock
+// and writes to it, but doesn't touch the words, so other threads can use the database meanwhile.
+// only one thread at a time can be syncing.
+void HistoryDatabase_prepare_sync(HistoryDatabase * database);
+void HistoryDatabase_write_log(HistoryDatabase * database);
+// this syncs first.
 void HistoryDatabase_delete(HistoryDatabase * database);
 void HistoryDatabase_add(HistoryDatabase * database, char * word);
+// same as HistoryDatabase_add, but the word doesn't need to be null terminated.
+void HistoryDatabase_add_n(HistoryDatabase * database, const char * word, size_t len);
+// returns non-zero if the word has been added and not forgotten since.
+char HistoryDatabase_contains(HistoryDatabase * database, const char * word, size_t len);
+// limits how many words are remembered. when there are too many, the least popular ones
+// (fewest hits, then least recently seen) are forgotten, and the hits of the rest are halved.
+// 0 means no limit, which is the default.
+void HistoryDatabase_set_max_words(HistoryDatabase * database, int max_words);
+// same idea, but limits the memory used by the words.
+void HistoryDatabase_set_max_bytes(HistoryDatabase * database, size_t max_bytes);
+
+// how many words are remembered, and roughly how much memory they take up.
+int HistoryDatabase_get_word_count(HistoryDatabase * database);
+size_t HistoryDatabase_get_memory_used(HistoryDatabase * database);
+
+// returns a null-terminated array of all the words starting with prefix, most popular first.
+// free each string and the array when you're done with them.
 char ** HistoryDatabase_prefix_matches(HistoryDatabase * database, char * prefix);
+// same as HistoryDatabase_prefix_matches, but only the k most popular words.
+// this is much faster than getting all the matches when there are a lot of them.
+// match_count, if not NULL, gets how many words start with prefix, including the ones left out.
+char ** HistoryDatabase_prefix_top_k(HistoryDatabase * database, char * prefix, int k, int * match_count);
+// returns how long the longest prefix shared by all the words starting with prefix is
+// (ignoring case, unless the database is case sensitive), or -1 if there aren't any.
+// this is quick however many words there are.
+int HistoryDatabase_common_prefix_len(HistoryDatabase * database, char * prefix);
 
 #endif
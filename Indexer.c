@@ -0,0 +1,187 @@
+#include "Indexer.h"
+
+#include "RingBuffer.h"
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// how much text can be waiting to be indexed before more gets dropped
+#define QUEUE_CAPACITY 0x400000
+// how many words to add between giving readers a chance at the database
+#define WORDS_PER_LOCK 0x100
+// set in a record's length when its words skip the filter
+#define ALWAYS_ADMIT_FLAG 0x80000000
+// time one word in this many. reading the clock for every word would cost more than some words do.
+#define ADD_TIME_SAMPLE_INTERVAL 16
+
+typedef struct {
+    HistoryDatabase * database;
+    Tokenizer * tokenizer;
+    AdmissionFilter * filter;
+    // records of a 32 bit length followed by that much text
+    RingBuffer * queue;
+    // posted whenever something is queued or it's time to stop
+    sem_t queue_signal;
+    atomic_int stopping;
+    pthread_mutex_t database_mutex;
+    pthread_t thread;
+    // the thread only touches this while holding database_mutex, except for the dropped counts,
+    // which belong to whoever calls Indexer_add_text.
+    IndexerStats stats;
+} InternalIndexer;
+
+static long long monotonic_nanoseconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static void index_text(InternalIndexer * secret_data, const char * text, size_t len, char always_admit)
+{
+    const char * cursor = text;
+    const char * end = text + len;
+    char more_words = 1;
+    while (more_words) {
+        pthread_mutex_lock(&secret_data->database_mutex);
+        int i;
+        for (i = 0; i < WORDS_PER_LOCK; i++) {
+            const char * word;
+            int word_len;
+            if (!Tokenizer_next(secret_data->tokenizer, &cursor, end, &word, &word_len)) {
+                more_words = 0;
+                break;
+            }
+            if (!always_admit && secret_data->filter != NULL &&
+                !HistoryDatabase_contains(secret_data->database, word, word_len) &&
+                !AdmissionFilter_admit(secret_data->filter, word, word_len))
+            {
+                secret_data->stats.words_rejected++;
+                continue;
+            }
+            if (secret_data->stats.words_added++ % ADD_TIME_SAMPLE_INTERVAL == 0) {
+                long long start_time = monotonic_nanoseconds();
+                HistoryDatabase_add_n(secret_data->database, word, word_len);
+                consoline_histogram_add(&secret_data->stats.add_time, monotonic_nanoseconds() - start_time);
+            } else {
+                HistoryDatabase_add_n(secret_data->database, word, word_len);
+            }
+        }
+        pthread_mutex_unlock(&secret_data->database_mutex);
+    }
+}
+
+static void * thread_main(void * data)
+{
+    InternalIndexer * secret_data = (InternalIndexer *)data;
+    char * text = NULL;
+    uint32_t text_capacity = 0;
+    for (;;) {
+        while (sem_wait(&secret_data->queue_signal) != 0 && errno == EINTR) {}
+        // check this before draining the queue. everything queued before stopping will be seen.
+        int stopping = atomic_load(&secret_data->stopping);
+        while (RingBuffer_available(secret_data->queue) != 0) {
+            // the producer commits whole records at once
+            uint32_t record_len;
+            RingBuffer_read(secret_data->queue, &record_len, sizeof(record_len));
+            uint32_t len = record_len & ~ALWAYS_ADMIT_FLAG;
+            if (len > text_capacity) {
+                text_capacity = len;
+                text = (char *)realloc(text, text_capacity);
+            }
+            RingBuffer_read(secret_data->queue, text, len);
+            index_text(secret_data, text, len, (record_len & ALWAYS_ADMIT_FLAG) != 0);
+        }
+        pthread_mutex_lock(&secret_data->database_mutex);
+        HistoryDatabase_prepare_sync(secret_data->database);
+        pthread_mutex_unlock(&secret_data->database_mutex);
+        // writing can wait on another process holding the file lock. don't make readers wait for that too.
+        HistoryDatabase_write_log(secret_data->database);
+        if (stopping)
+            break;
+    }
+    free(text);
+    return NULL;
+}
+
+Indexer * Indexer_create(HistoryDatabase * database, Tokenizer * tokenizer, AdmissionFilter * filter)
+{
+    InternalIndexer * secret_data = (InternalIndexer *)malloc(sizeof(InternalIndexer));
+    secret_data->database = database;
+    secret_data->tokenizer = tokenizer;
+    secret_data->filter = filter;
+    secret_data->queue = RingBuffer_create(QUEUE_CAPACITY);
+    sem_init(&secret_data->queue_signal, 0, 0);
+    atomic_init(&secret_data->stopping, 0);
+    pthread_mutex_init(&secret_data->database_mutex, NULL);
+    memset(&secret_data->stats, 0, sizeof(IndexerStats));
+
+    // signals are for the thread that started us
+    sigset_t all_signals;
+    sigset_t old_mask;
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_BLOCK, &all_signals, &old_mask);
+    pthread_create(&secret_data->thread, NULL, thread_main, secret_data);
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+
+    Indexer * indexer = (Indexer *)malloc(sizeof(Indexer));
+    indexer->_secret_data = secret_data;
+    return indexer;
+}
+
+void Indexer_delete(Indexer * indexer)
+{
+    InternalIndexer * secret_data = (InternalIndexer *)indexer->_secret_data;
+    atomic_store(&secret_data->stopping, 1);
+    sem_post(&secret_data->queue_signal);
+    pthread_join(secret_data->thread, NULL);
+    pthread_mutex_destroy(&secret_data->database_mutex);
+    sem_destroy(&secret_data->queue_signal);
+    RingBuffer_delete(secret_data->queue);
+    free(secret_data);
+    free(indexer);
+}
+
+void Indexer_add_text(Indexer * indexer, const char * text, size_t len, char always_admit)
+{
+    InternalIndexer * secret_data = (InternalIndexer *)indexer->_secret_data;
+    uint32_t record_len = len;
+    if (always_admit)
+        record_len |= ALWAYS_ADMIT_FLAG;
+    if (len == 0 || len >= ALWAYS_ADMIT_FLAG)
+        return;
+    if (RingBuffer_free_space(secret_data->queue) < sizeof(record_len) + len) {
+        secret_data->stats.texts_dropped++;
+        secret_data->stats.bytes_dropped += len;
+        return;
+    }
+    RingBuffer_write(secret_data->queue, &record_len, sizeof(record_len));
+    RingBuffer_write(secret_data->queue, text, len);
+    RingBuffer_commit(secret_data->queue);
+    sem_post(&secret_data->queue_signal);
+}
+
+void Indexer_get_stats(Indexer * indexer, IndexerStats * stats)
+{
+    InternalIndexer * secret_data = (InternalIndexer *)indexer->_secret_data;
+    pthread_mutex_lock(&secret_data->database_mutex);
+    *stats = secret_data->stats;
+    pthread_mutex_unlock(&secret_data->database_mutex);
+}
+
+void Indexer_lock_database(Indexer * indexer)
+{
+    InternalIndexer * secret_data = (InternalIndexer *)indexer->_secret_data;
+    pthread_mutex_lock(&secret_data->database_mutex);
+}
+
+void Indexer_unlock_database(Indexer * indexer)
+{
+    InternalIndexer * secret_data = (InternalIndexer *)indexer->_secret_data;
+    pthread_mutex_unlock(&secret_data->database_mutex);
+}
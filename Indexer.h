@@ -0,0 +1,46 @@
+#ifndef _INDEXER_H_
+#define _INDEXER_H_
+
+#include "HistoryDatabase.h"
+#include "Tokenizer.h"
+#include "AdmissionFilter.h"
+#include "consoline.h"
+
+// adds the words of text to a HistoryDatabase on a background thread,
+// so that splitting and indexing lots of output doesn't hold up the caller.
+
+typedef struct {
+    void * _secret_data;
+} Indexer;
+
+// starts the thread. the database, tokenizer, and filter must outlive the indexer.
+// filter can be NULL to add every word. words that are already in the database always get through.
+// while the indexer exists, only use the database between Indexer_lock_database and Indexer_unlock_database.
+Indexer * Indexer_create(HistoryDatabase * database, Tokenizer * tokenizer, AdmissionFilter * filter);
+// indexes everything that's been queued, syncs the database, and stops the thread.
+void Indexer_delete(Indexer * indexer);
+
+// queues a copy of the text to be indexed. only call this from one thread.
+// besides the tokenizer's separators, null characters separate words too.
+// this never blocks. if the thread has fallen too far behind, the text is dropped.
+// if always_admit is non-zero, the words skip the filter.
+void Indexer_add_text(Indexer * indexer, const char * text, size_t len, char always_admit);
+
+typedef struct {
+    // text that Indexer_add_text dropped because the thread had fallen behind
+    unsigned long long texts_dropped;
+    unsigned long long bytes_dropped;
+    unsigned long long words_added;
+    // words that the filter kept out
+    unsigned long long words_rejected;
+    // how long adding a word to the database takes. only some of the words are timed.
+    struct consoline_histogram add_time;
+} IndexerStats;
+// call this from the same thread as Indexer_add_text.
+void Indexer_get_stats(Indexer * indexer, IndexerStats * stats);
+
+// the thread only holds the lock for a few words at a time.
+void Indexer_lock_database(Indexer * indexer);
+void Indexer_unlock_database(Indexer * indexer);
+
+#endif
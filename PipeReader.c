@@ -0,0 +1,148 @@
+#include "PipeReader.h"
+
+#include "RingBuffer.h"
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+
+// how much to ask for per read(). this is the default size of a pipe buffer on linux.
+#define READ_SIZE 0x10000
+
+typedef struct {
+    int fd;
+    RingBuffer * buffer;
+    // set after the last of the input has been committed to buffer
+    atomic_int input_closed;
+    int event_fd;
+    // set by the thread when it's waiting for space in the buffer
+    atomic_int waiting_for_space;
+    sem_t space_signal;
+    atomic_ullong times_full;
+    atomic_int stopping;
+    pthread_t thread;
+} InternalPipeReader;
+
+static void signal_event(InternalPipeReader * secret_data)
+{
+    uint64_t one = 1;
+    write(secret_data->event_fd, &one, sizeof(one));
+}
+
+static void wait_for_space(InternalPipeReader * secret_data)
+{
+    atomic_fetch_add_explicit(&secret_data->times_full, 1, memory_order_relaxed);
+    atomic_store(&secret_data->waiting_for_space, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+    while (RingBuffer_free_space(secret_data->buffer) == 0 && !atomic_load(&secret_data->stopping))
+        while (sem_wait(&secret_data->space_signal) != 0 && errno == EINTR) {}
+    atomic_store(&secret_data->waiting_for_space, 0);
+}
+
+static void * thread_main(void * data)
+{
+    InternalPipeReader * secret_data = (InternalPipeReader *)data;
+    char * chunk = (char *)malloc(READ_SIZE);
+    while (!atomic_load(&secret_data->stopping)) {
+        size_t free_space = RingBuffer_free_space(secret_data->buffer);
+        if (free_space == 0) {
+            wait_for_space(secret_data);
+            continue;
+        }
+        ssize_t read_count = read(secret_data->fd, chunk, free_space < READ_SIZE ? free_space : READ_SIZE);
+        if (read_count < 0 && errno == EINTR)
+            continue;
+        if (read_count <= 0)
+            break;
+        RingBuffer_write(secret_data->buffer, chunk, read_count);
+        RingBuffer_commit(secret_data->buffer);
+        signal_event(secret_data);
+    }
+    // errors count as the end of the input too
+    atomic_store(&secret_data->input_closed, 1);
+    signal_event(secret_data);
+    free(chunk);
+    return NULL;
+}
+
+PipeReader * PipeReader_create(int fd, size_t capacity)
+{
+    InternalPipeReader * secret_data = (InternalPipeReader *)malloc(sizeof(InternalPipeReader));
+    secret_data->fd = fd;
+    secret_data->buffer = RingBuffer_create(capacity);
+    atomic_init(&secret_data->input_closed, 0);
+    secret_data->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    atomic_init(&secret_data->waiting_for_space, 0);
+    atomic_init(&secret_data->times_full, 0);
+    sem_init(&secret_data->space_signal, 0, 0);
+    atomic_init(&secret_data->stopping, 0);
+
+    // signals are for the thread that started us
+    sigset_t all_signals;
+    sigset_t old_mask;
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_BLOCK, &all_signals, &old_mask);
+    pthread_create(&secret_data->thread, NULL, thread_main, secret_data);
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+
+    PipeReader * reader = (PipeReader *)malloc(sizeof(PipeReader));
+    reader->_secret_data = secret_data;
+    return reader;
+}
+
+void PipeReader_delete(PipeReader * reader)
+{
+    InternalPipeReader * secret_data = (InternalPipeReader *)reader->_secret_data;
+    atomic_store(&secret_data->stopping, 1);
+    sem_post(&secret_data->space_signal);
+    // the thread might be stuck in read()
+    pthread_cancel(secret_data->thread);
+    pthread_join(secret_data->thread, NULL);
+    sem_destroy(&secret_data->space_signal);
+    close(secret_data->event_fd);
+    RingBuffer_delete(secret_data->buffer);
+    free(secret_data);
+    free(reader);
+}
+
+int PipeReader_get_event_fd(PipeReader * reader)
+{
+    InternalPipeReader * secret_data = (InternalPipeReader *)reader->_secret_data;
+    return secret_data->event_fd;
+}
+
+int PipeReader_read(PipeReader * reader, char * buffer, int len)
+{
+    InternalPipeReader * secret_data = (InternalPipeReader *)reader->_secret_data;
+    // check this first. once it's set, everything has been committed.
+    int input_closed = atomic_load(&secret_data->input_closed);
+    size_t available = RingBuffer_available(secret_data->buffer);
+    if (available == 0) {
+        if (input_closed)
+            return 0;
+        // make the event fd not readable, unless more came in just now
+        uint64_t count;
+        read(secret_data->event_fd, &count, sizeof(count));
+        if (RingBuffer_available(secret_data->buffer) != 0 || atomic_load(&secret_data->input_closed))
+            signal_event(secret_data);
+        errno = EAGAIN;
+        return -1;
+    }
+    if (available < len)
+        len = available;
+    RingBuffer_read(secret_data->buffer, buffer, len);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_exchange(&secret_data->waiting_for_space, 0))
+        sem_post(&secret_data->space_signal);
+    return len;
+}
+
+unsigned long long PipeReader_get_times_full(PipeReader * reader)
+{
+    InternalPipeReader * secret_data = (InternalPipeReader *)reader->_secret_data;
+    return atomic_load_explicit(&secret_data->times_full, memory_order_relaxed);
+}
@@ -0,0 +1,29 @@
+#ifndef _PIPE_READER_H_
+#define _PIPE_READER_H_
+
+#include <stddef.h>
+
+// reads a file descriptor on a background thread as fast as it can be written,
+// and keeps what was read in a buffer until it's asked for.
+// this way whoever is writing to the file descriptor never waits for the reader.
+
+typedef struct {
+    void * _secret_data;
+} PipeReader;
+
+// starts the thread. fd must be in blocking mode. at most capacity bytes are buffered,
+// after that the thread stops reading until some are asked for.
+PipeReader * PipeReader_create(int fd, size_t capacity);
+// stops the thread. the file descriptor isn't closed.
+void PipeReader_delete(PipeReader * reader);
+
+// readable whenever PipeReader_read() has something to return, including the end of the input.
+int PipeReader_get_event_fd(PipeReader * reader);
+// works like read(). returns 0 at the end of the input,
+// or -1 with errno set to EAGAIN if nothing is buffered right now.
+// only call this from one thread.
+int PipeReader_read(PipeReader * reader, char * buffer, int len);
+// how many times the buffer has filled up, so that the thread had to stop reading.
+unsigned long long PipeReader_get_times_full(PipeReader * reader);
+
+#endif
@@ -0,0 +1,208 @@
+#include "RadixTree.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static RadixTree_Node * new_node(RadixTree * t, const char * label, int label_len, void * value)
+{
+    RadixTree_Node * node = (RadixTree_Node *)Arena_alloc(t->arena, sizeof(RadixTree_Node));
+    node->label = label;
+    node->label_len = label_len;
+    node->value = value;
+    node->children_len = 0;
+    node->children_cap = 0;
+    node->children = NULL;
+    node->child_bytes = NULL;
+    return node;
+}
+
+static RadixTree_Node * find_child(RadixTree_Node * node, unsigned char c)
+{
+    unsigned char * found = (unsigned char *)memchr(node->child_bytes, c, node->children_len);
+    if (found == NULL)
+        return NULL;
+    return node->children[found - node->child_bytes];
+}
+
+static int log2_of_cap(int cap)
+{
+    int result = 0;
+    while ((1 << result) < cap)
+        result++;
+    return result;
+}
+static RadixTree_Node ** alloc_child_array(RadixTree * t, int cap)
+{
+    int size_index = log2_of_cap(cap);
+    RadixTree_Node ** array = t->free_child_arrays[size_index];
+    if (array != NULL) {
+        t->free_child_arrays[size_index] = (RadixTree_Node **)array[0];
+        return array;
+    }
+    return (RadixTree_Node **)Arena_alloc(t->arena, cap * (sizeof(RadixTree_Node *) + 1));
+}
+static void free_child_array(RadixTree * t, RadixTree_Node ** array, int cap)
+{
+    int size_index = log2_of_cap(cap);
+    array[0] = (RadixTree_Node *)t->free_child_arrays[size_index];
+    t->free_child_arrays[size_index] = array;
+}
+
+static void add_child(RadixTree * t, RadixTree_Node * node, RadixTree_Node * child)
+{
+    if (node->children_len == node->children_cap) {
+        // most nodes have very few children, so start small
+        int new_cap = node->children_cap == 0 ? 2 : node->children_cap * 2;
+        RadixTree_Node ** new_children = alloc_child_array(t, new_cap);
+        unsigned char * new_child_bytes = (unsigned char *)(new_children + new_cap);
+        memcpy(new_children, node->children, node->children_len * sizeof(RadixTree_Node *));
+        memcpy(new_child_bytes, node->child_bytes, node->children_len);
+        if (node->children != NULL)
+            free_child_array(t, node->children, node->children_cap);
+        node->children = new_children;
+        node->child_bytes = new_child_bytes;
+        node->children_cap = new_cap;
+    }
+    node->children[node->children_len] = child;
+    node->child_bytes[node->children_len] = (unsigned char)child->label[0];
+    node->children_len++;
+}
+
+static void replace_child(RadixTree_Node * node, RadixTree_Node * old_child, RadixTree_Node * new_child)
+{
+    int i;
+    for (i = 0; i < node->children_len; i++) {
+        if (node->children[i] == old_child) {
+            node->children[i] = new_child;
+            return;
+        }
+    }
+}
+
+static int common_prefix_len(const char * a, const char * b, int max_len)
+{
+    int i;
+    for (i = 0; i < max_len; i++)
+        if (a[i] != b[i])
+            break;
+    return i;
+}
+
+RadixTree * RadixTree_create()
+{
+    RadixTree * t = (RadixTree *)malloc(sizeof(RadixTree));
+    t->arena = Arena_create();
+    memset(t->free_child_arrays, 0, sizeof(t->free_child_arrays));
+    t->root = new_node(t, NULL, 0, NULL);
+    t->size = 0;
+    return t;
+}
+
+static char traverse_subtree(RadixTree_Node * node, RadixTree_visitor_func visitor, void * data);
+void RadixTree_delete(RadixTree * t, RadixTree_visitor_func delete_visitor)
+{
+    if (delete_visitor != NULL)
+        traverse_subtree(t->root, delete_visitor, NULL);
+    Arena_delete(t->arena);
+    free(t);
+}
+
+void * RadixTree_get(RadixTree * t, const char * key, int key_len)
+{
+    RadixTree_Node * node = t->root;
+    int position = 0;
+    while (position < key_len) {
+        node = find_child(node, (unsigned char)key[position]);
+        if (node == NULL)
+            return NULL;
+        if (node->label_len > key_len - position)
+            return NULL;
+        if (memcmp(node->label, key + position, node->label_len) != 0)
+            return NULL;
+        position += node->label_len;
+    }
+    return node->value;
+}
+
+void RadixTree_put(RadixTree * t, const char * key, int key_len, void * value)
+{
+    RadixTree_Node * node = t->root;
+    int position = 0;
+    while (position < key_len) {
+        RadixTree_Node * child = find_child(node, (unsigned char)key[position]);
+        if (child == NULL) {
+            // the rest of the key becomes a new leaf
+            add_child(t, node, new_node(t, key + position, key_len - position, value));
+            t->size++;
+            return;
+        }
+        int max_len = child->label_len < key_len - position ? child->label_len : key_len - position;
+        int common_len = common_prefix_len(child->label, key + position, max_len);
+        if (common_len < child->label_len) {
+            // the key diverges in the middle of the child's label. split the label.
+            RadixTree_Node * middle = new_node(t, child->label, common_len, NULL);
+            replace_child(node, child, middle);
+            child->label += common_len;
+            child->label_len -= common_len;
+            add_child(t, middle, child);
+            child = middle;
+        }
+        node = child;
+        position += common_len;
+    }
+    if (node->value == NULL)
+        t->size++;
+    node->value = value;
+}
+
+static char traverse_subtree(RadixTree_Node * node, RadixTree_visitor_func visitor, void * data)
+{
+    if (node->value != NULL && !visitor(node->value, data))
+        return 0;
+    int i;
+    for (i = 0; i < node->children_len; i++)
+        if (!traverse_subtree(node->children[i], visitor, data))
+            return 0;
+    return 1;
+}
+
+void RadixTree_traverse_prefix(RadixTree * t, const char * prefix, int prefix_len, RadixTree_visitor_func visitor, void * data)
+{
+    RadixTree_Node * node = t->root;
+    int position = 0;
+    while (position < prefix_len) {
+        node = find_child(node, (unsigned char)prefix[position]);
+        if (node == NULL)
+            return;
+        // the prefix may end in the middle of a label
+        int compare_len = node->label_len < prefix_len - position ? node->label_len : prefix_len - position;
+        if (memcmp(node->label, prefix + position, compare_len) != 0)
+            return;
+        position += compare_len;
+    }
+    traverse_subtree(node, visitor, data);
+}
+
+int RadixTree_common_prefix_len(RadixTree * t, const char * prefix, int prefix_len)
+{
+    RadixTree_Node * node = t->root;
+    // where the label of node ends
+    int position = 0;
+    while (position < prefix_len) {
+        node = find_child(node, (unsigned char)prefix[position]);
+        if (node == NULL)
+            return -1;
+        int compare_len = node->label_len < prefix_len - position ? node->label_len : prefix_len - position;
+        if (memcmp(node->label, prefix + position, compare_len) != 0)
+            return -1;
+        position += node->label_len;
+    }
+    if (node->value == NULL && node->children_len == 0)
+        return -1;
+    // the keys all go the same way until one of them ends or they branch
+    while (node->value == NULL && node->children_len == 1) {
+        node = node->children[0];
+        position += node->label_len;
+    }
+    return position;
+}
@@ -0,0 +1,59 @@
+#ifndef _RADIX_TREE_H_
+#define _RADIX_TREE_H_
+
+// a path-compressed trie mapping byte strings to values.
+// lookups cost O(key length), and finding everything that starts with a
+// prefix costs O(prefix length) plus the size of the output.
+
+#include "Arena.h"
+
+typedef struct RadixTree_Node_ {
+    // the bytes of the key between the parent node and this node.
+    // this points into the key of some entry that was put in the tree.
+    const char * label;
+    int label_len;
+    // NULL if no key ends at this node.
+    void * value;
+    int children_len;
+    int children_cap;
+    // children and child_bytes share one allocation so a lookup touches as few cache lines as possible.
+    struct RadixTree_Node_ ** children;
+    // the first byte of each child's label, parallel to children.
+    unsigned char * child_bytes;
+} RadixTree_Node;
+
+// a node has at most 256 children, so child arrays have at most 9 different capacities.
+#define RadixTree_CHILD_ARRAY_SIZES 9
+
+typedef struct {
+    RadixTree_Node * root;
+    int size;
+    // all the nodes and child arrays are allocated here.
+    Arena * arena;
+    // child arrays that were outgrown, indexed by log2 of their capacity, waiting to be reused.
+    // each one stores the next one in its first slot.
+    RadixTree_Node ** free_child_arrays[RadixTree_CHILD_ARRAY_SIZES];
+} RadixTree;
+
+typedef char (*RadixTree_visitor_func)(void * value, void * data);
+
+RadixTree * RadixTree_create();
+// the visitor, if non NULL, is called with each value so it can be freed.
+// the visitor will get NULL for the data parameter and the return value is ignored.
+// without a visitor, this takes time proportional to the memory used, not the number of nodes.
+void RadixTree_delete(RadixTree * t, RadixTree_visitor_func delete_visitor);
+
+void * RadixTree_get(RadixTree * t, const char * key, int key_len);
+// the tree does not copy the key. its memory must stay valid and unchanged until the tree is deleted.
+// value must not be NULL.
+void RadixTree_put(RadixTree * t, const char * key, int key_len, void * value);
+
+// Calls the visitor function for the value of each key that starts with the prefix, in no particular order.
+// Visitor is called with the data provided, whatever it is.
+// Visitor should return non-zero to continue and 0 to terminate traversal.
+void RadixTree_traverse_prefix(RadixTree * t, const char * prefix, int prefix_len, RadixTree_visitor_func visitor, void * data);
+// returns how long the longest prefix shared by all the keys that start with prefix is,
+// or -1 if no key starts with prefix. takes O(length of the result), however many keys there are.
+int RadixTree_common_prefix_len(RadixTree * t, const char * prefix, int prefix_len);
+
+#endif
@@ -0,0 +1,65 @@
+#include "RingBuffer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+RingBuffer * RingBuffer_create(size_t capacity)
+{
+    size_t rounded_capacity = 1;
+    while (rounded_capacity < capacity)
+        rounded_capacity *= 2;
+    RingBuffer * ring = (RingBuffer *)malloc(sizeof(RingBuffer));
+    ring->data = (char *)malloc(rounded_capacity);
+    ring->capacity = rounded_capacity;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    ring->write_position = 0;
+    return ring;
+}
+
+void RingBuffer_delete(RingBuffer * ring)
+{
+    free(ring->data);
+    free(ring);
+}
+
+size_t RingBuffer_free_space(RingBuffer * ring)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return ring->capacity - (ring->write_position - tail);
+}
+
+void RingBuffer_write(RingBuffer * ring, const void * data, size_t len)
+{
+    size_t offset = ring->write_position & (ring->capacity - 1);
+    size_t first_part_len = ring->capacity - offset;
+    if (first_part_len > len)
+        first_part_len = len;
+    // the data might wrap around the end
+    memcpy(ring->data + offset, data, first_part_len);
+    memcpy(ring->data, (const char *)data + first_part_len, len - first_part_len);
+    ring->write_position += len;
+}
+
+void RingBuffer_commit(RingBuffer * ring)
+{
+    atomic_store_explicit(&ring->head, ring->write_position, memory_order_release);
+}
+
+size_t RingBuffer_available(RingBuffer * ring)
+{
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    return head - atomic_load_explicit(&ring->tail, memory_order_relaxed);
+}
+
+void RingBuffer_read(RingBuffer * ring, void * data, size_t len)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t offset = tail & (ring->capacity - 1);
+    size_t first_part_len = ring->capacity - offset;
+    if (first_part_len > len)
+        first_part_len = len;
+    memcpy(data, ring->data + offset, first_part_len);
+    memcpy((char *)data + first_part_len, ring->data, len - first_part_len);
+    atomic_store_explicit(&ring->tail, tail + len, memory_order_release);
+}
@@ -0,0 +1,39 @@
+#ifndef _RING_BUFFER_H_
+#define _RING_BUFFER_H_
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+// a fixed size byte queue for passing data from one thread to another without locking.
+// exactly one thread may call the producer functions and exactly one thread may call the consumer functions.
+
+typedef struct {
+    char * data;
+    // a power of two
+    size_t capacity;
+    // total bytes ever committed by the producer
+    atomic_size_t head;
+    // total bytes ever consumed by the consumer
+    atomic_size_t tail;
+    // only the producer uses this. it's ahead of head by the bytes written but not committed yet.
+    size_t write_position;
+} RingBuffer;
+
+// capacity is rounded up to a power of two.
+RingBuffer * RingBuffer_create(size_t capacity);
+void RingBuffer_delete(RingBuffer * ring);
+
+// producer: how many bytes can be written right now.
+size_t RingBuffer_free_space(RingBuffer * ring);
+// producer: copies data in. the caller must have checked the free space.
+// the consumer doesn't see the data until it's committed.
+void RingBuffer_write(RingBuffer * ring, const void * data, size_t len);
+// producer: makes everything written so far visible to the consumer.
+void RingBuffer_commit(RingBuffer * ring);
+
+// consumer: how many committed bytes are waiting to be read.
+size_t RingBuffer_available(RingBuffer * ring);
+// consumer: copies data out and frees up the space. the caller must have checked what's available.
+void RingBuffer_read(RingBuffer * ring, void * data, size_t len);
+
+#endif
@@ -0,0 +1,40 @@
+#include "Tokenizer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+Tokenizer * Tokenizer_create(const char * separators)
+{
+    Tokenizer * tokenizer = (Tokenizer *)malloc(sizeof(Tokenizer));
+    memset(tokenizer->is_separator, 0, sizeof(tokenizer->is_separator));
+    tokenizer->is_separator[0] = 1;
+    int i;
+    for (i = 0; separators[i] != '\0'; i++)
+        tokenizer->is_separator[(unsigned char)separators[i]] = 1;
+    return tokenizer;
+}
+
+void Tokenizer_delete(Tokenizer * tokenizer)
+{
+    free(tokenizer);
+}
+
+char Tokenizer_next(Tokenizer * tokenizer, const char ** cursor, const char * end, const char ** word, int * word_len)
+{
+    const char * is_separator = tokenizer->is_separator;
+    const char * position = *cursor;
+    // skip separators
+    while (position < end && is_separator[(unsigned char)*position])
+        position++;
+    if (position == end) {
+        *cursor = position;
+        return 0;
+    }
+    const char * word_start = position;
+    while (position < end && !is_separator[(unsigned char)*position])
+        position++;
+    *word = word_start;
+    *word_len = position - word_start;
+    *cursor = position;
+    return 1;
+}
@@ -0,0 +1,21 @@
+#ifndef _TOKENIZER_H_
+#define _TOKENIZER_H_
+
+// splits text into words without copying anything.
+// the words are pointers into the text, with lengths.
+
+typedef struct {
+    char is_separator[256];
+} Tokenizer;
+
+// separators is a null-terminated string of the characters that separate words.
+// null characters always separate words too.
+Tokenizer * Tokenizer_create(const char * separators);
+void Tokenizer_delete(Tokenizer * tokenizer);
+
+// finds the first word in the text from *cursor up to end.
+// on success, sets *word and *word_len, moves *cursor past the word, and returns non-zero.
+// returns 0 when there are no more words.
+char Tokenizer_next(Tokenizer * tokenizer, const char ** cursor, const char * end, const char ** word, int * word_len);
+
+#endif
@@ -0,0 +1,500 @@
+/*
+ * Benchmarks for the pieces of consoline, and for the consoline binary as a whole.
+ * Results are printed to stdout as JSON, so they can be compared between versions.
+ *
+ * Usage:
+ *     benchmark [--quick]
+ *     benchmark --emit COUNT INTERVAL_NS
+ *
+ * --quick runs smaller sizes. --emit is how the end-to-end benchmarks use this
+ * program as the child of ./consoline: it prints COUNT timestamped lines,
+ * waiting INTERVAL_NS between them, or as fast as possible if that's 0.
+ */
+
+#define _GNU_SOURCE
+#include "consoline.h"
+#include "HistoryDatabase.h"
+#include "RadixTree.h"
+#include "Tokenizer.h"
+
+#include <pthread.h>
+#include <pty.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+// the end-to-end benchmarks run the binary next to us
+#define CONSOLINE_PATH "./consoline"
+#define EMIT_PREFIX "BENCH "
+// readline needs the escapes marked as taking up no space
+#define COLOR_PROMPT "\001\033[1;32m\002consoline\001\033[0m\002> "
+
+static long long now_nanoseconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// the same numbers every run
+static uint64_t random_state = 0x9e3779b97f4a7c15ULL;
+static uint64_t next_random()
+{
+    // xorshift64
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    return random_state;
+}
+// mostly small numbers, like how a few words show up much more often than the rest
+static int skewed_random(int limit)
+{
+    double uniform = (next_random() >> 11) * (1.0 / 9007199254740992.0);
+    return (int)(limit * uniform * uniform * uniform);
+}
+
+// results are collected and printed at the end, because some benchmarks borrow stdout.
+typedef struct {
+    char name[64];
+    long long size;
+    const char * unit;
+    double value;
+} Result;
+static Result * results = NULL;
+static int results_len = 0;
+static int results_capacity = 0;
+static void report(const char * name, long long size, const char * unit, double value)
+{
+    if (results_len == results_capacity) {
+        results_capacity = results_capacity == 0 ? 0x40 : results_capacity * 2;
+        results = (Result *)realloc(results, results_capacity * sizeof(Result));
+    }
+    Result * result = &results[results_len++];
+    snprintf(result->name, sizeof(result->name), "%s", name);
+    result->size = size;
+    result->unit = unit;
+    result->value = value;
+}
+static void print_results()
+{
+    printf("{\n    \"results\": [\n");
+    int i;
+    for (i = 0; i < results_len; i++) {
+        printf("        {\"name\": \"%s\", \"size\": %lld, \"unit\": \"%s\", \"value\": %.3f}%s\n",
+                results[i].name, results[i].size, results[i].unit, results[i].value, i + 1 < results_len ? "," : "");
+    }
+    printf("    ]\n}\n");
+}
+
+// words are made up of letters, 3 to 10 of them.
+typedef struct {
+    char * text;
+    int * offsets;
+    int * lens;
+    int count;
+} Vocabulary;
+static Vocabulary * make_vocabulary(int count)
+{
+    Vocabulary * vocabulary = (Vocabulary *)malloc(sizeof(Vocabulary));
+    vocabulary->text = (char *)malloc(count * 11);
+    vocabulary->offsets = (int *)malloc(count * sizeof(int));
+    vocabulary->lens = (int *)malloc(count * sizeof(int));
+    vocabulary->count = count;
+    int position = 0;
+    int i;
+    for (i = 0; i < count; i++) {
+        int len = 3 + next_random() % 8;
+        vocabulary->offsets[i] = position;
+        vocabulary->lens[i] = len;
+        int j;
+        for (j = 0; j < len; j++)
+            vocabulary->text[position++] = 'a' + next_random() % 26;
+        vocabulary->text[position++] = '\0';
+    }
+    return vocabulary;
+}
+static void delete_vocabulary(Vocabulary * vocabulary)
+{
+    free(vocabulary->text);
+    free(vocabulary->offsets);
+    free(vocabulary->lens);
+    free(vocabulary);
+}
+
+static void free_matches(char ** matches)
+{
+    int i;
+    for (i = 0; matches[i] != NULL; i++)
+        free(matches[i]);
+    free(matches);
+}
+
+#define QUERY_COUNT 1000
+static void bench_history_database(int word_count)
+{
+    // one distinct word for every ten added
+    int vocabulary_size = word_count / 10 < 1000 ? 1000 : word_count / 10;
+    Vocabulary * vocabulary = make_vocabulary(vocabulary_size);
+    int * picks = (int *)malloc(word_count * sizeof(int));
+    int i;
+    for (i = 0; i < word_count; i++)
+        picks[i] = skewed_random(vocabulary_size);
+
+    HistoryDatabase * database = HistoryDatabase_create(0);
+    long long start = now_nanoseconds();
+    for (i = 0; i < word_count; i++)
+        HistoryDatabase_add_n(database, vocabulary->text + vocabulary->offsets[picks[i]], vocabulary->lens[picks[i]]);
+    long long elapsed = now_nanoseconds() - start;
+    report("HistoryDatabase_add", word_count, "ns/op", (double)elapsed / word_count);
+
+    // prefixes of real words, so that there are matches
+    char prefixes[QUERY_COUNT][4];
+    int prefix_len;
+    for (prefix_len = 2; prefix_len <= 3; prefix_len++) {
+        for (i = 0; i < QUERY_COUNT; i++) {
+            memcpy(prefixes[i], vocabulary->text + vocabulary->offsets[next_random() % vocabulary_size], prefix_len);
+            prefixes[i][prefix_len] = '\0';
+        }
+        start = now_nanoseconds();
+        for (i = 0; i < QUERY_COUNT; i++)
+            free_matches(HistoryDatabase_prefix_top_k(database, prefixes[i], 100, NULL));
+        elapsed = now_nanoseconds() - start;
+        char name[64];
+        snprintf(name, sizeof(name), "HistoryDatabase_prefix_top_k/%d_letters", prefix_len);
+        report(name, word_count, "ns/op", (double)elapsed / QUERY_COUNT);
+    }
+    // everything that matches is much more work, so use longer prefixes
+    for (i = 0; i < QUERY_COUNT; i++) {
+        memcpy(prefixes[i], vocabulary->text + vocabulary->offsets[next_random() % vocabulary_size], 3);
+        prefixes[i][3] = '\0';
+    }
+    start = now_nanoseconds();
+    for (i = 0; i < QUERY_COUNT; i++)
+        free_matches(HistoryDatabase_prefix_matches(database, prefixes[i]));
+    elapsed = now_nanoseconds() - start;
+    report("HistoryDatabase_prefix_matches/3_letters", word_count, "ns/op", (double)elapsed / QUERY_COUNT);
+
+    HistoryDatabase_delete(database);
+    free(picks);
+    delete_vocabulary(vocabulary);
+}
+
+static char count_visitor(void * value, void * data)
+{
+    (*(int *)data)++;
+    return 1;
+}
+static void bench_radix_tree(int key_count)
+{
+    Vocabulary * vocabulary = make_vocabulary(key_count);
+    RadixTree * tree = RadixTree_create();
+    long long start = now_nanoseconds();
+    int i;
+    for (i = 0; i < key_count; i++)
+        RadixTree_put(tree, vocabulary->text + vocabulary->offsets[i], vocabulary->lens[i], vocabulary);
+    long long elapsed = now_nanoseconds() - start;
+    report("RadixTree_put", key_count, "ns/op", (double)elapsed / key_count);
+
+    start = now_nanoseconds();
+    int found = 0;
+    for (i = 0; i < key_count; i++)
+        found += RadixTree_get(tree, vocabulary->text + vocabulary->offsets[i], vocabulary->lens[i]) != NULL;
+    elapsed = now_nanoseconds() - start;
+    report("RadixTree_get", key_count, "ns/op", (double)elapsed / key_count);
+
+    int visited = 0;
+    start = now_nanoseconds();
+    RadixTree_traverse_prefix(tree, "", 0, count_visitor, &visited);
+    elapsed = now_nanoseconds() - start;
+    report("RadixTree_traverse_prefix/all", key_count, "ns/key", (double)elapsed / (visited > 0 ? visited : 1));
+
+    RadixTree_delete(tree, NULL);
+    delete_vocabulary(vocabulary);
+    if (found != key_count)
+        fprintf(stderr, "RadixTree_get found %d of %d keys\n", found, key_count);
+}
+
+static void bench_tokenizer(int line_count)
+{
+    // looks like a server log
+    char * text = (char *)malloc((size_t)line_count * 100);
+    size_t len = 0;
+    int i;
+    for (i = 0; i < line_count; i++) {
+        len += sprintf(text + len, "%08d INFO request=%x handled by worker-%d in %d ms status=ok\n",
+                i, (unsigned)next_random(), i % 16, i % 997);
+    }
+    char * separators = consoline_get_completion_separators();
+    Tokenizer * tokenizer = Tokenizer_create(separators);
+    free(separators);
+    const char * cursor = text;
+    const char * word;
+    int word_len;
+    long long word_count = 0;
+    long long start = now_nanoseconds();
+    while (Tokenizer_next(tokenizer, &cursor, text + len, &word, &word_len))
+        word_count++;
+    long long elapsed = now_nanoseconds() - start;
+    report("Tokenizer_next", line_count, "MB/s", len / (elapsed / 1e9) / 1e6);
+    report("Tokenizer_next", line_count, "ns/word", (double)elapsed / word_count);
+    Tokenizer_delete(tokenizer);
+    free(text);
+}
+
+// reads everything from a pseudo-terminal master until it's closed, counting the bytes.
+typedef struct {
+    int fd;
+    long long byte_count;
+} Drainer;
+static void * drain_thread(void * data)
+{
+    Drainer * drainer = (Drainer *)data;
+    char buffer[0x10000];
+    for (;;) {
+        ssize_t count = read(drainer->fd, buffer, sizeof(buffer));
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            break;
+        drainer->byte_count += count;
+    }
+    return NULL;
+}
+
+// how much it costs to print a line above an input line that's being typed,
+// including hiding and redrawing the input line, on a terminal that keeps up.
+static void bench_println(const char * name, int line_count, int max_redraw_hz, char scroll_region, const char * prompt, const char * typed)
+{
+    struct winsize window_size;
+    memset(&window_size, 0, sizeof(window_size));
+    window_size.ws_row = 24;
+    window_size.ws_col = 80;
+    int master_fd;
+    int slave_fd;
+    if (openpty(&master_fd, &slave_fd, NULL, NULL, &window_size) == -1) {
+        perror("openpty");
+        return;
+    }
+    // the pseudo-terminal takes the place of ours while consoline is using it
+    fflush(stdout);
+    int saved_stdin = dup(STDIN_FILENO);
+    int saved_stdout = dup(STDOUT_FILENO);
+    dup2(slave_fd, STDIN_FILENO);
+    dup2(slave_fd, STDOUT_FILENO);
+    Drainer drainer;
+    drainer.fd = master_fd;
+    drainer.byte_count = 0;
+    pthread_t thread;
+    pthread_create(&thread, NULL, drain_thread, &drainer);
+
+    consoline_init("benchmark", prompt);
+    consoline_set_max_redraw_hz(max_redraw_hz);
+    consoline_set_scroll_region(scroll_region);
+    write(master_fd, typed, strlen(typed));
+    // wait for readline to see it
+    usleep(10000);
+    consoline_poll();
+
+    char line[100];
+    long long start = now_nanoseconds();
+    int i;
+    for (i = 0; i < line_count; i++) {
+        snprintf(line, sizeof(line), "%08d INFO a line of output that is about as long as a typical log line", i);
+        consoline_println(line);
+        if (max_redraw_hz > 0 && i % 100 == 0)
+            consoline_poll();
+    }
+    consoline_deinit();
+    long long elapsed = now_nanoseconds() - start;
+
+    // give our terminal back, and let the drainer see the end
+    fflush(stdout);
+    dup2(saved_stdin, STDIN_FILENO);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdin);
+    close(saved_stdout);
+    close(slave_fd);
+    pthread_join(thread, NULL);
+    close(master_fd);
+
+    report(name, line_count, "ns/line", (double)elapsed / line_count);
+    report(name, line_count, "terminal_bytes/line", (double)drainer.byte_count / line_count);
+}
+
+static int compare_long_long(const void * left, const void * right)
+{
+    long long a = *(const long long *)left;
+    long long b = *(const long long *)right;
+    return a < b ? -1 : a > b;
+}
+
+// runs ./consoline on a pseudo-terminal with ourselves emitting timestamped lines as the child,
+// and measures how long it takes the lines to come out the other side.
+// with save_history, the words for completion are saved to a file too.
+static void bench_end_to_end(const char * self_path, int line_count, long long interval_nanoseconds, char save_history)
+{
+    struct winsize window_size;
+    memset(&window_size, 0, sizeof(window_size));
+    window_size.ws_row = 24;
+    window_size.ws_col = 80;
+    int master_fd;
+    int slave_fd;
+    if (openpty(&master_fd, &slave_fd, NULL, NULL, &window_size) == -1) {
+        perror("openpty");
+        return;
+    }
+    char count_arg[32];
+    char interval_arg[32];
+    snprintf(count_arg, sizeof(count_arg), "%d", line_count);
+    snprintf(interval_arg, sizeof(interval_arg), "%lld", interval_nanoseconds);
+    char history_path[64];
+    snprintf(history_path, sizeof(history_path), "/tmp/consoline_bench_history.%d", (int)getpid());
+    char history_arg[128];
+    snprintf(history_arg, sizeof(history_arg), "--history-file=%s", history_path);
+    long long start = now_nanoseconds();
+    pid_t pid = fork();
+    if (pid == 0) {
+        setsid();
+        ioctl(slave_fd, TIOCSCTTY, 0);
+        dup2(slave_fd, STDIN_FILENO);
+        dup2(slave_fd, STDOUT_FILENO);
+        dup2(slave_fd, STDERR_FILENO);
+        close(slave_fd);
+        close(master_fd);
+        if (save_history)
+            execl(CONSOLINE_PATH, CONSOLINE_PATH, history_arg, self_path, "--emit", count_arg, interval_arg, (char *)NULL);
+        else
+            execl(CONSOLINE_PATH, CONSOLINE_PATH, self_path, "--emit", count_arg, interval_arg, (char *)NULL);
+        perror(CONSOLINE_PATH);
+        exit(1);
+    }
+    close(slave_fd);
+
+    long long * latencies = (long long *)malloc(line_count * sizeof(long long));
+    int latencies_len = 0;
+    long long last_line_time = start;
+    // lines can be split across reads
+    char buffer[0x10000 + 256];
+    int buffer_len = 0;
+    for (;;) {
+        ssize_t count = read(master_fd, buffer + buffer_len, sizeof(buffer) - 256);
+        if (count < 0 && errno == EINTR)
+            continue;
+        // EIO means everyone has closed the other end
+        if (count <= 0)
+            break;
+        long long now = now_nanoseconds();
+        buffer_len += count;
+        char * line_start = buffer;
+        char * end = buffer + buffer_len;
+        char * newline;
+        while ((newline = (char *)memchr(line_start, '\n', end - line_start)) != NULL) {
+            char * found = (char *)memmem(line_start, newline - line_start, EMIT_PREFIX, strlen(EMIT_PREFIX));
+            if (found != NULL && latencies_len < line_count) {
+                latencies[latencies_len++] = now - strtoll(found + strlen(EMIT_PREFIX), NULL, 10);
+                last_line_time = now;
+            }
+            line_start = newline + 1;
+        }
+        buffer_len = end - line_start;
+        // a line that long isn't ours. forget it.
+        if (buffer_len > 256)
+            buffer_len = 0;
+        memmove(buffer, line_start, buffer_len);
+    }
+    waitpid(pid, NULL, 0);
+    close(master_fd);
+    if (save_history) {
+        unlink(history_path);
+        char log_path[80];
+        snprintf(log_path, sizeof(log_path), "%s.log", history_path);
+        unlink(log_path);
+    }
+
+    const char * name = interval_nanoseconds > 0 ? "end_to_end/paced" : "end_to_end/flood";
+    if (save_history)
+        name = interval_nanoseconds > 0 ? "end_to_end/paced_history_file" : "end_to_end/flood_history_file";
+    if (latencies_len != line_count)
+        fprintf(stderr, "%s: only saw %d of %d lines\n", name, latencies_len, line_count);
+    if (latencies_len == 0)
+        return;
+    if (interval_nanoseconds == 0) {
+        report(name, line_count, "lines/s", latencies_len / ((last_line_time - start) / 1e9));
+    } else {
+        qsort(latencies, latencies_len, sizeof(long long), compare_long_long);
+        report(name, line_count, "p50_latency_us", latencies[latencies_len / 2] / 1e3);
+        report(name, line_count, "p99_latency_us", latencies[latencies_len * 99 / 100] / 1e3);
+    }
+    free(latencies);
+}
+
+static void emit(int line_count, long long interval_nanoseconds)
+{
+    char buffer[0x10000];
+    int buffer_len = 0;
+    long long next_time = now_nanoseconds();
+    int i;
+    for (i = 0; i < line_count; i++) {
+        if (interval_nanoseconds > 0) {
+            // each line goes out on its own, on schedule. sleep rather than spin,
+            // so that this doesn't take a core away from the consoline being measured.
+            struct timespec wake_time;
+            wake_time.tv_sec = next_time / 1000000000LL;
+            wake_time.tv_nsec = next_time % 1000000000LL;
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake_time, NULL) == EINTR) {}
+            next_time += interval_nanoseconds;
+            int len = snprintf(buffer, sizeof(buffer), EMIT_PREFIX "%lld\n", now_nanoseconds());
+            write(STDOUT_FILENO, buffer, len);
+            continue;
+        }
+        if (buffer_len > sizeof(buffer) - 64) {
+            write(STDOUT_FILENO, buffer, buffer_len);
+            buffer_len = 0;
+        }
+        buffer_len += snprintf(buffer + buffer_len, sizeof(buffer) - buffer_len, EMIT_PREFIX "%lld\n", now_nanoseconds());
+    }
+    write(STDOUT_FILENO, buffer, buffer_len);
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc == 4 && strcmp(argv[1], "--emit") == 0) {
+        emit(atoi(argv[2]), atoll(argv[3]));
+        return 0;
+    }
+    char quick = argc == 2 && strcmp(argv[1], "--quick") == 0;
+    if (argc > 1 && !quick) {
+        fprintf(stderr, "usage: %s [--quick]\n", argv[0]);
+        return 1;
+    }
+
+    bench_history_database(10000);
+    bench_history_database(quick ? 100000 : 1000000);
+    if (!quick)
+        bench_history_database(10000000);
+    bench_radix_tree(quick ? 100000 : 1000000);
+    bench_tokenizer(quick ? 100000 : 1000000);
+    int println_count = quick ? 10000 : 100000;
+    bench_println("consoline_println", println_count, 0, 0, "> ", "something being typed");
+    bench_println("consoline_println/max_redraw_hz_60", println_count, 60, 0, "> ", "something being typed");
+    // wraps onto a second line of the 80 column terminal
+    bench_println("consoline_println/long_input_color_prompt", println_count, 0, 0, COLOR_PROMPT,
+            "a long command line being typed, long enough that it doesn't fit on one line of the terminal, or even close");
+    // the same, but the input line is never redrawn
+    bench_println("consoline_println/scroll_region", println_count, 0, 1, COLOR_PROMPT,
+            "a long command line being typed, long enough that it doesn't fit on one line of the terminal, or even close");
+    bench_end_to_end(argv[0], quick ? 100000 : 1000000, 0, 0);
+    bench_end_to_end(argv[0], quick ? 1000 : 5000, 200000, 0);
+    bench_end_to_end(argv[0], quick ? 100000 : 1000000, 0, 1);
+    bench_end_to_end(argv[0], quick ? 1000 : 5000, 200000, 1);
+
+    print_results();
+    return 0;
+}
@@ -0,0 +1,41 @@
+#!/bin/sh
+# Pipes a large generated log through the consoline binary and reports how fast it went.
+# Usage: ./bench_throughput.sh [line_count]
+
+set -e
+
+LINE_COUNT=${1:-1000000}
+CONSOLINE=${CONSOLINE:-./consoline}
+LOG_FILE=$(mktemp)
+HISTORY_FILE=$(mktemp -u)
+trap 'rm -f "$LOG_FILE" "$HISTORY_FILE" "$HISTORY_FILE.log"' EXIT
+
+awk -v n="$LINE_COUNT" 'BEGIN {
+    for (i = 0; i < n; i++)
+        printf "%08d INFO request=%x handled by worker-%d in %d ms status=ok\n", i, i * 2654435761 % 4294967296, i % 16, i % 997
+}' > "$LOG_FILE"
+BYTE_COUNT=$(wc -c < "$LOG_FILE")
+
+now() {
+    date +%s.%N
+}
+
+run() {
+    label=$1
+    shift
+    start=$(now)
+    "$CONSOLINE" "$@" cat "$LOG_FILE" < /dev/null > /dev/null
+    end=$(now)
+    awk -v label="$label" -v lines="$LINE_COUNT" -v bytes="$BYTE_COUNT" -v start="$start" -v end="$end" 'BEGIN {
+        seconds = end - start
+        printf "%-16s %8.3f s %12.0f lines/s %10.2f MB/s\n", label, seconds, lines / seconds, bytes / seconds / 1000000
+    }'
+}
+
+echo "$LINE_COUNT lines, $BYTE_COUNT bytes"
+# stdin and stdout aren't terminals here, so turn off passthrough to measure the line editing path
+run "completion" --no-passthrough
+run "history file" --no-passthrough --history-file="$HISTORY_FILE"
+run "no completion" --no-passthrough --no-completion
+run "threads" --no-passthrough --no-completion --threads
+run "passthrough"
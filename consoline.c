@@ -3,16 +3,30 @@
  * https://github.com/dpc/xmppconsole/blob/master/src/io.c
  */
 
+#define _GNU_SOURCE
 #include "consoline.h"
 
 #include <readline/readline.h>
 #include <readline/history.h>
 #include <unistd.h>
+#include <sys/uio.h>
+#include <sys/eventfd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/ioctl.h>
+#include <termcap.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <signal.h>
 #include <errno.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 
 static const char* current_prompt = NULL;
 static char current_leave_entered_lines_on_stdout = 1;
@@ -21,6 +35,10 @@ static void (*current_line_handler)(char * line) = NULL;
 static char** (*current_completion_handler)(char * line, int start, int end, const char * text) = NULL;
 
 static fd_set stdin_fd_set;
+// only this thread touches readline. see consoline_init().
+static pthread_t owner_thread;
+// set once readline reports the end of input. stdin stays readable forever after that.
+static char input_closed = 0;
 
 static void handle_line_fake(char* line)
 {
@@ -28,32 +46,584 @@ static void handle_line_fake(char* line)
         rl_set_prompt(current_prompt);
         rl_already_prompted = 1;
     } else {
+        input_closed = 1;
         if (current_eof_handler != NULL)
             current_eof_handler();
     }
 }
 
+static void reset_scroll_region();
 static void async_print(void (*print_func)(void*), void* data)
 {
-    char* saved_line = rl_copy_text(0, rl_end);
-    int saved_point = rl_point;
-
-    rl_set_prompt("");
-    rl_replace_line("", 0);
-    rl_redisplay();
+    // this needs the whole screen to scroll
+    reset_scroll_region();
+    // erase the prompt and input line, however many rows they take up, and go to the start of the first one.
+    // the line being typed stays where it is in readline.
+    rl_clear_visible_line();
     (*print_func)(data);
+    // then draw them again from scratch after the output
+    rl_on_new_line();
+    rl_redisplay();
+}
 
-    rl_set_prompt(current_prompt);
-    rl_replace_line(saved_line, 0);
-    rl_point = saved_point;
+// writes all of the buffers, retrying after partial writes.
+static void write_fully(struct iovec * iov, int iov_count)
+{
+    while (iov_count > 0) {
+        ssize_t written = writev(STDOUT_FILENO, iov, iov_count < IOV_MAX ? iov_count : IOV_MAX);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN) {
+                // only possible for a non-blocking stdout that someone else set up
+                struct pollfd stdout_poll = { STDOUT_FILENO, POLLOUT, 0 };
+                poll(&stdout_poll, 1, -1);
+                continue;
+            }
+            return;
+        }
+        // skip past what got written
+        while (iov_count > 0 && written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            iov_count--;
+        }
+        if (iov_count > 0) {
+            iov->iov_base = (char *)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+}
+
+// output waits here until stdout can take it without blocking, and when the
+// redraw rate is limited, until it's time to hide and redraw the input line again.
+// this only ever holds complete lines, starting at pending_output_start.
+static int current_max_redraw_hz = 0;
+static char * pending_output = NULL;
+static int pending_output_start = 0;
+static int pending_output_len = 0;
+static int pending_output_capacity = 0;
+static long long last_flush_time = 0;
+// what to do when there's more than this much output waiting. 0 means no limit.
+static size_t current_output_buffer_limit = 0x100000;
+static enum consoline_overflow_policy current_overflow_policy = CONSOLINE_OVERFLOW_BLOCK;
+// set when stdout couldn't take any more. cleared once it can.
+static char stdout_is_blocked = 0;
+// lines dropped that haven't been reported in the output yet
+static int unreported_dropped_lines = 0;
+// with CONSOLINE_OVERFLOW_DROP_OLDEST, the report goes at the start of pending_output. this is its length.
+static int dropped_lines_report_len = 0;
+static struct consoline_stats stats;
+
+static long long monotonic_nanoseconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static int pending_output_size()
+{
+    return pending_output_len - pending_output_start;
+}
+
+// returns a place to put len more bytes of output
+static char * reserve_pending_output(int len)
+{
+    if (pending_output_len + len > pending_output_capacity) {
+        // slide everything back to the beginning first
+        memmove(pending_output, pending_output + pending_output_start, pending_output_size());
+        pending_output_len -= pending_output_start;
+        pending_output_start = 0;
+    }
+    if (pending_output_len + len > pending_output_capacity) {
+        pending_output_capacity = pending_output_capacity == 0 ? 0x1000 : pending_output_capacity * 2;
+        if (pending_output_capacity < pending_output_len + len)
+            pending_output_capacity = pending_output_len + len;
+        pending_output = (char *)realloc(pending_output, pending_output_capacity * sizeof(char));
+    }
+    char * result = pending_output + pending_output_len;
+    pending_output_len += len;
+    return result;
+}
+static void queue_output(const char * text, int len)
+{
+    memcpy(reserve_pending_output(len), text, len);
+}
+
+static int format_dropped_lines_report(char * buffer, int size)
+{
+    return snprintf(buffer, size, "[%d line%s dropped]\n", unreported_dropped_lines, unreported_dropped_lines == 1 ? "" : "s");
+}
+static void queue_dropped_lines_report()
+{
+    char report[64];
+    queue_output(report, format_dropped_lines_report(report, sizeof(report)));
+    unreported_dropped_lines = 0;
+}
+
+// makes room for len more bytes by dropping lines from the start, and says so at the start.
+static void drop_oldest_lines(int len)
+{
+    // the old report gets replaced with one that includes it
+    pending_output_start += dropped_lines_report_len;
+    while (pending_output_size() > 0 && pending_output_size() + len > current_output_buffer_limit) {
+        char * start = pending_output + pending_output_start;
+        char * newline = (char *)memchr(start, '\n', pending_output_size());
+        pending_output_start += newline + 1 - start;
+        unreported_dropped_lines++;
+        stats.lines_dropped++;
+    }
+    dropped_lines_report_len = 0;
+    if (unreported_dropped_lines == 0)
+        return;
+    char report[64];
+    dropped_lines_report_len = format_dropped_lines_report(report, sizeof(report));
+    if (dropped_lines_report_len > pending_output_start) {
+        reserve_pending_output(dropped_lines_report_len);
+        memmove(pending_output + pending_output_start + dropped_lines_report_len,
+                pending_output + pending_output_start, pending_output_size() - dropped_lines_report_len);
+        pending_output_start += dropped_lines_report_len;
+    }
+    pending_output_start -= dropped_lines_report_len;
+    memcpy(pending_output + pending_output_start, report, dropped_lines_report_len);
+}
+
+static void flush_pending_output();
+// returns where to put a line of len bytes, including its newline,
+// or NULL if the overflow policy says to drop it.
+static char * reserve_line(int len)
+{
+    stats.lines_printed++;
+    stats.bytes_printed += len;
+    if (current_output_buffer_limit > 0 && pending_output_size() + len > current_output_buffer_limit) {
+        switch (current_overflow_policy) {
+            case CONSOLINE_OVERFLOW_BLOCK:
+                stats.blocked_count++;
+                flush_pending_output();
+                break;
+            case CONSOLINE_OVERFLOW_DROP_OLDEST:
+                drop_oldest_lines(len);
+                break;
+            case CONSOLINE_OVERFLOW_DROP_NEWEST:
+                unreported_dropped_lines++;
+                stats.lines_dropped++;
+                return NULL;
+        }
+    }
+    if (current_overflow_policy == CONSOLINE_OVERFLOW_DROP_NEWEST && unreported_dropped_lines > 0)
+        queue_dropped_lines_report();
+    return reserve_pending_output(len);
+}
+// text doesn't include the newline
+static void queue_line(const char * text, int len)
+{
+    char * destination = reserve_line(len + 1);
+    if (destination == NULL)
+        return;
+    memcpy(destination, text, len);
+    destination[len] = '\n';
+}
+
+// writes as much as stdout will take without blocking, but never stops in the middle of a line,
+// so that the input line can be redrawn. returns how much was written.
+static int write_lines_without_blocking(const char * data, int len)
+{
+    int flags = fcntl(STDOUT_FILENO, F_GETFL);
+    // the terminal is probably shared with other processes, so only be non-blocking for a moment.
+    if (!(flags & O_NONBLOCK))
+        fcntl(STDOUT_FILENO, F_SETFL, flags | O_NONBLOCK);
+    int written = 0;
+    while (written < len) {
+        ssize_t count = write(STDOUT_FILENO, data + written, len - written);
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                stats.stdout_would_block_count++;
+                stdout_is_blocked = 1;
+            } else {
+                // nothing can be done about it. don't try again.
+                written = len;
+            }
+            break;
+        }
+        written += count;
+    }
+    if (!(flags & O_NONBLOCK))
+        fcntl(STDOUT_FILENO, F_SETFL, flags);
+    if (written > 0 && written < len && data[written - 1] != '\n') {
+        // finish the line. it can't be long. the last line might not have a newline.
+        const char * newline = (const char *)memchr(data + written, '\n', len - written);
+        const char * line_end = newline != NULL ? newline + 1 : data + len;
+        struct iovec iov;
+        iov.iov_base = (char *)data + written;
+        iov.iov_len = line_end - (data + written);
+        write_fully(&iov, 1);
+        written += iov.iov_len;
+    }
+    return written;
+}
+
+// returns how much was written
+static int write_output_lines(const char * data, int len, char blocking)
+{
+    if (!blocking)
+        return write_lines_without_blocking(data, len);
+    struct iovec iov;
+    iov.iov_base = (char *)data;
+    iov.iov_len = len;
+    write_fully(&iov, 1);
+    return len;
+}
+static void consume_pending_output(int written)
+{
+    pending_output_start += written;
+    if (dropped_lines_report_len > 0 && written >= dropped_lines_report_len) {
+        unreported_dropped_lines = 0;
+        dropped_lines_report_len = 0;
+    }
+    if (pending_output_start == pending_output_len) {
+        pending_output_start = 0;
+        pending_output_len = 0;
+    }
+}
+static void pending_output_func(void* blocking)
+{
+    // readline writes through stdio. make sure that comes out first.
+    fflush(stdout);
+    consume_pending_output(write_output_lines(pending_output + pending_output_start, pending_output_size(), blocking != NULL));
+}
+
+// with consoline_set_scroll_region(1), the input line stays on the bottom row of the terminal,
+// and output scrolls in a region above it, so printing never touches the input line.
+static char scroll_region_enabled = 0;
+// the region is taken down whenever something besides output needs to print,
+// and put back up for the next output.
+static char scroll_region_is_set = 0;
+// the terminal's height when the region was set
+static int scroll_region_rows = 0;
+// the last line of output is left without its newline, so that the bottom row of the region isn't blank.
+// this is set when that newline needs to be written before any more output.
+static char scroll_region_owes_newline = 0;
+// readline's setting from before the scroll region. the input line can't wrap onto another row.
+static char * saved_horizontal_scroll_mode = NULL;
+// from termcap
+static char termcap_buffer[0x400];
+static char * change_scroll_region_capability = NULL;
+static char * cursor_address_capability = NULL;
+static char * save_cursor_capability = NULL;
+static char * restore_cursor_capability = NULL;
+// takes the region down without moving the cursor. kept ready for the signal handler.
+static char scroll_region_reset_sequence[0x80];
+static int scroll_region_reset_sequence_len = 0;
+
+static char load_scroll_region_capabilities()
+{
+    char * area = termcap_buffer;
+    change_scroll_region_capability = tgetstr("cs", &area);
+    cursor_address_capability = tgetstr("cm", &area);
+    save_cursor_capability = tgetstr("sc", &area);
+    restore_cursor_capability = tgetstr("rc", &area);
+    return change_scroll_region_capability != NULL && cursor_address_capability != NULL &&
+        save_cursor_capability != NULL && restore_cursor_capability != NULL;
+}
+// tputs() takes out any padding
+static char * termcap_output;
+static char * termcap_output_end;
+static int put_termcap_char(int c)
+{
+    if (termcap_output < termcap_output_end)
+        *termcap_output++ = c;
+    return c;
+}
+// appends a capability string to destination. returns the new end.
+static char * append_capability(char * destination, char * destination_end, const char * capability)
+{
+    termcap_output = destination;
+    termcap_output_end = destination_end;
+    tputs(capability, 1, put_termcap_char);
+    return termcap_output;
+}
+// cs takes the bottom row first. rows count from 0.
+static char * append_scroll_region(char * destination, char * destination_end, int top, int bottom)
+{
+    return append_capability(destination, destination_end, tgoto(change_scroll_region_capability, bottom, top));
+}
+static char * append_cursor_address(char * destination, char * destination_end, int row, int column)
+{
+    return append_capability(destination, destination_end, tgoto(cursor_address_capability, column, row));
+}
+
+static int get_terminal_rows()
+{
+    struct winsize window_size;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &window_size) == 0 && window_size.ws_row > 0)
+        return window_size.ws_row;
+    int rows;
+    int columns;
+    rl_get_screen_size(&rows, &columns);
+    return rows;
+}
+static void write_sequence(const char * start, const char * end)
+{
+    struct iovec iov;
+    iov.iov_base = (char *)start;
+    iov.iov_len = end - start;
+    write_fully(&iov, 1);
+}
+// a full screen region for a terminal this tall
+static void prepare_scroll_region_reset_sequence(int rows)
+{
+    char * sequence_end = scroll_region_reset_sequence + sizeof(scroll_region_reset_sequence);
+    char * end = append_capability(scroll_region_reset_sequence, sequence_end, save_cursor_capability);
+    end = append_scroll_region(end, sequence_end, 0, rows - 1);
+    end = append_capability(end, sequence_end, restore_cursor_capability);
+    scroll_region_reset_sequence_len = end - scroll_region_reset_sequence;
+}
+// returns 0 if the terminal is too short for it
+static char set_scroll_region()
+{
+    int rows = get_terminal_rows();
+    if (scroll_region_is_set && rows == scroll_region_rows)
+        return 1;
+    if (rows < 3) {
+        reset_scroll_region();
+        return 0;
+    }
+    // erase the input line from wherever it is, and draw it again on the bottom row
+    rl_clear_visible_line();
+    fflush(stdout);
+    char sequence[0x80];
+    char * sequence_end = sequence + sizeof(sequence);
+    char * end = append_scroll_region(sequence, sequence_end, 0, rows - 2);
+    end = append_cursor_address(end, sequence_end, rows - 1, 0);
+    write_sequence(sequence, end);
+    rl_on_new_line();
     rl_redisplay();
 
-    free(saved_line);
+    prepare_scroll_region_reset_sequence(rows);
+    scroll_region_rows = rows;
+    // whatever is on the bottom row of the region now stays
+    scroll_region_owes_newline = 1;
+    scroll_region_is_set = 1;
+    return 1;
+}
+static void reset_scroll_region()
+{
+    if (!scroll_region_is_set)
+        return;
+    scroll_region_is_set = 0;
+    fflush(stdout);
+    write_sequence(scroll_region_reset_sequence, scroll_region_reset_sequence + scroll_region_reset_sequence_len);
+}
+// writes the output on the bottom row of the region, and goes back to the input line.
+static void write_to_scroll_region(char blocking)
+{
+    // readline writes through stdio. make sure that comes out first.
+    fflush(stdout);
+    char sequence[0x80];
+    char * sequence_end = sequence + sizeof(sequence);
+    char * end = append_capability(sequence, sequence_end, save_cursor_capability);
+    end = append_cursor_address(end, sequence_end, scroll_region_rows - 2, 0);
+    if (scroll_region_owes_newline)
+        *end++ = '\n';
+    write_sequence(sequence, end);
+    // everything but the last newline
+    int len = pending_output_size();
+    int written = write_output_lines(pending_output + pending_output_start, len - 1, blocking);
+    if (written == len - 1)
+        written = len;
+    // if it stopped early, it stopped after a newline
+    scroll_region_owes_newline = written == len;
+    end = append_capability(sequence, sequence_end, restore_cursor_capability);
+    write_sequence(sequence, end);
+    consume_pending_output(written);
+}
+static void write_pending_output(char blocking)
+{
+    if (!blocking) {
+        struct pollfd stdout_poll;
+        stdout_poll.fd = STDOUT_FILENO;
+        stdout_poll.events = POLLOUT;
+        if (poll(&stdout_poll, 1, 0) == 0) {
+            // don't bother hiding the input line
+            stats.stdout_would_block_count++;
+            stdout_is_blocked = 1;
+            return;
+        }
+    }
+    stdout_is_blocked = 0;
+    long long start_time = monotonic_nanoseconds();
+    if (scroll_region_enabled && set_scroll_region())
+        write_to_scroll_region(blocking);
+    else
+        async_print(pending_output_func, blocking ? &blocking : NULL);
+    last_flush_time = monotonic_nanoseconds();
+    consoline_histogram_add(&stats.redraw_time, last_flush_time - start_time);
+}
+// writes everything that's waiting, even if that means waiting for stdout.
+static void flush_pending_output()
+{
+    if (current_overflow_policy == CONSOLINE_OVERFLOW_DROP_NEWEST && unreported_dropped_lines > 0)
+        queue_dropped_lines_report();
+    if (pending_output_size() == 0)
+        return;
+    write_pending_output(1);
+}
+static long long nanoseconds_until_flush_is_due()
+{
+    if (current_max_redraw_hz <= 0)
+        return 0;
+    long long interval = 1000000000LL / current_max_redraw_hz;
+    return last_flush_time + interval - monotonic_nanoseconds();
+}
+// consoline_get_fd() is an epoll file descriptor watching everything that consoline_poll() deals with.
+// only the things that need attention are watched, so that it's not readable while there's nothing to do.
+static int epoll_fd = -1;
+// goes off when held back output is due
+static int redraw_timer_fd = -1;
+static char redraw_timer_is_armed = 0;
+// written by the signal handler for ctrl+c
+static int wake_event_fd = -1;
+static char epoll_is_watching_stdin = 0;
+static char epoll_is_watching_stdout = 0;
+
+static void epoll_watch(int fd, int events)
+{
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.fd = fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+}
+// only makes system calls when something has changed
+static void update_wakeups()
+{
+    if (epoll_fd == -1)
+        return;
+    if (input_closed && epoll_is_watching_stdin) {
+        // stdin is readable forever after the end
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, STDIN_FILENO, NULL);
+        epoll_is_watching_stdin = 0;
+    }
+    char waiting_for_stdout = consoline_is_waiting_for_stdout();
+    if (waiting_for_stdout != epoll_is_watching_stdout) {
+        if (waiting_for_stdout)
+            epoll_watch(STDOUT_FILENO, EPOLLOUT);
+        else
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, STDOUT_FILENO, NULL);
+        epoll_is_watching_stdout = waiting_for_stdout;
+    }
+    // flushes only ever push the due time later, so a timer that's already armed won't be late.
+    // if it's early, consoline_on_readable() arms it again.
+    if (pending_output_size() > 0 && !stdout_is_blocked && current_max_redraw_hz > 0 && !redraw_timer_is_armed) {
+        long long due_time = last_flush_time + 1000000000LL / current_max_redraw_hz;
+        struct itimerspec timer;
+        memset(&timer, 0, sizeof(timer));
+        timer.it_value.tv_sec = due_time / 1000000000LL;
+        timer.it_value.tv_nsec = due_time % 1000000000LL;
+        // zero would disarm it
+        if (due_time <= 0)
+            timer.it_value.tv_nsec = 1;
+        timerfd_settime(redraw_timer_fd, TFD_TIMER_ABSTIME, &timer, NULL);
+        redraw_timer_is_armed = 1;
+    }
+}
+static void flush_pending_output_if_due()
+{
+    // the report for dropped lines waits until there's room
+    if (current_overflow_policy == CONSOLINE_OVERFLOW_DROP_NEWEST && unreported_dropped_lines > 0 &&
+        pending_output_size() < current_output_buffer_limit)
+        queue_dropped_lines_report();
+    if (pending_output_size() > 0 && nanoseconds_until_flush_is_due() <= 0)
+        write_pending_output(0);
+    update_wakeups();
+}
+
+// lines printed from other threads wait here until consoline_poll() prints them.
+// producers push onto a lock-free stack, and the consumer takes the whole stack at once,
+// so nobody ever waits for anybody else or for the terminal.
+struct queued_output {
+    struct queued_output * next;
+    int len;
+    // one or more lines, each ending in a newline
+    char text[];
+};
+static _Atomic(struct queued_output *) queued_output_stack = NULL;
+// readable when the stack stops being empty
+static int queued_output_event_fd = -1;
+
+static char is_owner_thread()
+{
+    return pthread_equal(pthread_self(), owner_thread);
+}
+static struct queued_output * allocate_queued_output(int len)
+{
+    struct queued_output * node = (struct queued_output *)malloc(sizeof(struct queued_output) + len);
+    node->len = len;
+    return node;
+}
+static void push_queued_output(struct queued_output * node)
+{
+    node->next = atomic_load_explicit(&queued_output_stack, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&queued_output_stack, &node->next, node,
+            memory_order_release, memory_order_relaxed)) {}
+    // only the first one needs to wake anybody up
+    if (node->next == NULL && queued_output_event_fd != -1) {
+        uint64_t one = 1;
+        write(queued_output_event_fd, &one, sizeof(one));
+    }
+}
+
+static void print_queued_output()
+{
+    struct queued_output * stack = atomic_exchange_explicit(&queued_output_stack, NULL, memory_order_acquire);
+    // always take the wakeup, even if the stack was empty. a producer that pushed just before
+    // the last exchange might have written it since, and then it would stay readable for nothing.
+    uint64_t count;
+    read(queued_output_event_fd, &count, sizeof(count));
+    // a producer that pushed after the exchange might have written the wakeup that was just taken.
+    // take its lines too, or they would wait for the next push.
+    struct queued_output * newer_stack = atomic_exchange_explicit(&queued_output_stack, NULL, memory_order_acquire);
+    if (stack == NULL && newer_stack == NULL)
+        return;
+    // the stacks are newest first
+    struct queued_output * list = NULL;
+    struct queued_output * stacks[] = { newer_stack, stack };
+    int i;
+    for (i = 0; i < 2; i++) {
+        while (stacks[i] != NULL) {
+            struct queued_output * next = stacks[i]->next;
+            stacks[i]->next = list;
+            list = stacks[i];
+            stacks[i] = next;
+        }
+    }
+    struct queued_output * node;
+    for (node = list; node != NULL; node = node->next) {
+        // the overflow policy works a line at a time
+        char * line = node->text;
+        char * end = node->text + node->len;
+        while (line < end) {
+            char * newline = (char *)memchr(line, '\n', end - line);
+            queue_line(line, newline - line);
+            line = newline + 1;
+        }
+    }
+    flush_pending_output_if_due();
+    while (list != NULL) {
+        struct queued_output * next = list->next;
+        free(list);
+        list = next;
+    }
 }
 
 
 static void done_with_input_line()
 {
+    // the entered line scrolls up with the rest of the screen
+    reset_scroll_region();
     if (current_leave_entered_lines_on_stdout) {
         // leave the input line
         // put cursor at the end of the input line
@@ -117,17 +687,116 @@ static void print_ctrl_c_message_func(void* nothing)
     printf("(^C again to quit)\n");
 }
 
-static char pending_ctrl_c = 0;
-void consoline_poll()
+// how many entered lines can be recalled with the up arrow
+#define DEFAULT_HISTORY_SIZE 1000
+
+// everything available on stdin is read at once, and readline gets it from here a byte at a time.
+static unsigned char input_buffer[0x1000];
+static int input_buffer_start = 0;
+static int input_buffer_len = 0;
+// set once read() says there's no more
+static char input_ended = 0;
+
+// readline only uses this to decide whether an escape is the start of a sequence.
+// it's only installed while there's something in input_buffer. otherwise readline checks stdin itself.
+static int input_is_buffered()
+{
+    return 1;
+}
+static char fill_input_buffer();
+static int getc_from_input_buffer(FILE * stream)
+{
+    // readline keeps asking while it sees more input available, like when text is pasted
+    if (input_buffer_start == input_buffer_len && !input_ended && !fill_input_buffer()) {
+        // readline wants more than has been typed. wait for it.
+        return rl_getc(stream);
+    }
+    if (input_buffer_start == input_buffer_len)
+        return EOF;
+    int c = input_buffer[input_buffer_start++];
+    if (input_buffer_start == input_buffer_len)
+        rl_input_available_hook = NULL;
+    return c;
+}
+// returns 0 if there's nothing to read right now
+static char fill_input_buffer()
 {
     struct timeval no_time;
     memset(&no_time, 0, sizeof(no_time));
-
     for (;;) {
+        FD_SET(STDIN_FILENO, &stdin_fd_set);
+        int count = select(FD_SETSIZE, &stdin_fd_set, NULL, NULL, &no_time);
+        if (count < 0) {
+            if (errno == EINTR)
+                continue; // ignore and try again
+            exit(1);
+        } else if (count == 0) {
+            return 0;
+        }
+        ssize_t len = read(STDIN_FILENO, input_buffer, sizeof(input_buffer));
+        if (len < 0 && errno == EINTR)
+            continue;
+        if (len < 0 && errno == EAGAIN)
+            return 0;
+        if (len <= 0) {
+            // readline sees the end when the buffer runs out
+            input_ended = 1;
+            return 1;
+        }
+        input_buffer_start = 0;
+        input_buffer_len = len;
+        rl_input_available_hook = input_is_buffered;
+        return 1;
+    }
+}
 
-        char* line = rl_copy_text(0, rl_end);
-        char input_line_is_blank = strcmp(line, "") == 0;
-        free(line);
+// readline would only catch this while it's reading a key, and would then put back whatever handler
+// was there when it first set up its own, dropping any installed since. this catches it instead,
+// so that a resize is dealt with right away. with a scroll region that matters, because it moves
+// the bottom row, and many terminals take the region down when they're resized.
+static volatile sig_atomic_t window_size_changed = 0;
+static struct sigaction next_sigwinch_action;
+static void sigwinch_handler(int code)
+{
+    window_size_changed = 1;
+    if (wake_event_fd != -1) {
+        uint64_t one = 1;
+        write(wake_event_fd, &one, sizeof(one));
+    }
+    if (next_sigwinch_action.sa_handler != SIG_DFL && next_sigwinch_action.sa_handler != SIG_IGN)
+        next_sigwinch_action.sa_handler(code);
+}
+static void catch_window_size_changes()
+{
+    rl_catch_sigwinch = 0;
+    struct sigaction action;
+    action.sa_handler = sigwinch_handler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGWINCH, &action, &next_sigwinch_action);
+}
+static void handle_window_size_change()
+{
+    window_size_changed = 0;
+    if (!scroll_region_is_set) {
+        // what readline would have done. it draws the input line again if the size changed.
+        rl_resize_terminal();
+        return;
+    }
+    // put the region up again from scratch, even if the height is the same,
+    // and draw the input line again on the new bottom row
+    rl_reset_screen_size();
+    prepare_scroll_region_reset_sequence(get_terminal_rows());
+    scroll_region_rows = 0;
+    set_scroll_region();
+}
+
+static char pending_ctrl_c = 0;
+// handles everything typed so far
+static void read_input()
+{
+    for (;;) {
+        char input_line_is_blank = rl_end == 0;
 
         if (!input_line_is_blank) {
             // gotta be twice in a row to send a real SIGINT
@@ -143,31 +812,139 @@ void consoline_poll()
                 // the first ctrl+c on a blank line
                 ctrl_c_should_propagate_anyway = 1;
                 // warn the user about it
+                flush_pending_output();
                 async_print(print_ctrl_c_message_func, NULL);
             }
 
             // print the prompt
             rl_redisplay();
         }
-        FD_SET(STDIN_FILENO, &stdin_fd_set);
-        int count = select(FD_SETSIZE, &stdin_fd_set, NULL, NULL, &no_time);
-        if (count < 0) {
-            if (errno == EINTR)
-                continue; // ignore and try again
-            exit(1);
-        } else if (count == 0) {
+        if (input_closed)
+            return;
+        if (input_buffer_start == input_buffer_len && !input_ended && !fill_input_buffer())
             return;
-        }
         rl_callback_read_char();
     }
 }
 
+void consoline_poll()
+{
+    if (window_size_changed)
+        handle_window_size_change();
+    print_queued_output();
+    flush_pending_output_if_due();
+    read_input();
+    update_wakeups();
+}
+
+void consoline_on_readable()
+{
+    // these are only for waking up. consoline_poll() checks for everything itself.
+    // it also takes the wakeup for lines queued by other threads, every time, even if the lines
+    // were already printed. whatever made the fd readable has been consumed by the time this returns.
+    uint64_t count;
+    if (read(redraw_timer_fd, &count, sizeof(count)) == sizeof(count))
+        redraw_timer_is_armed = 0;
+    read(wake_event_fd, &count, sizeof(count));
+    consoline_poll();
+}
+
 void consoline_set_prompt(const char * prompt)
 {
     current_prompt = prompt;
     rl_set_prompt(current_prompt);
 }
 
+void consoline_set_max_redraw_hz(int hz)
+{
+    current_max_redraw_hz = hz;
+    if (current_max_redraw_hz <= 0)
+        flush_pending_output();
+}
+
+int consoline_get_poll_timeout()
+{
+    // waiting for stdout is a different thing
+    if (pending_output_size() == 0 || stdout_is_blocked)
+        return -1;
+    long long nanoseconds = nanoseconds_until_flush_is_due();
+    if (nanoseconds <= 0)
+        return 0;
+    // round up, so that we don't wake up just before it's time
+    return (nanoseconds + 999999) / 1000000;
+}
+
+char consoline_is_waiting_for_stdout()
+{
+    return pending_output_size() > 0 && stdout_is_blocked;
+}
+
+void consoline_set_output_buffer_limit(size_t bytes, enum consoline_overflow_policy policy)
+{
+    // don't leave a report for the old policy behind
+    flush_pending_output();
+    current_output_buffer_limit = bytes;
+    current_overflow_policy = policy;
+}
+
+void consoline_histogram_add(struct consoline_histogram * histogram, long long nanoseconds)
+{
+    histogram->count++;
+    if (nanoseconds <= 0)
+        nanoseconds = 1;
+    histogram->total_nanoseconds += nanoseconds;
+    // the position of the highest bit
+    int bucket = 63 - __builtin_clzll(nanoseconds);
+    if (bucket >= CONSOLINE_HISTOGRAM_BUCKETS)
+        bucket = CONSOLINE_HISTOGRAM_BUCKETS - 1;
+    histogram->buckets[bucket]++;
+}
+
+long long consoline_histogram_percentile(const struct consoline_histogram * histogram, double percent)
+{
+    if (histogram->count == 0)
+        return 0;
+    unsigned long long wanted = (unsigned long long)(histogram->count * percent / 100);
+    unsigned long long seen = 0;
+    int bucket;
+    for (bucket = 0; bucket < CONSOLINE_HISTOGRAM_BUCKETS - 1; bucket++) {
+        seen += histogram->buckets[bucket];
+        if (seen > 0 && seen >= wanted)
+            break;
+    }
+    // everything in the bucket is shorter than this
+    return 2LL << bucket;
+}
+
+char consoline_set_scroll_region(char bool_value)
+{
+    if (bool_value == scroll_region_enabled)
+        return 1;
+    // the output so far goes out the old way
+    flush_pending_output();
+    if (bool_value) {
+        if (!isatty(STDOUT_FILENO) || !load_scroll_region_capabilities())
+            return 0;
+        saved_horizontal_scroll_mode = strdup(rl_variable_value("horizontal-scroll-mode"));
+        rl_variable_bind("horizontal-scroll-mode", "on");
+        // the region goes up with the first output
+        scroll_region_enabled = 1;
+    } else {
+        reset_scroll_region();
+        rl_variable_bind("horizontal-scroll-mode", saved_horizontal_scroll_mode);
+        free(saved_horizontal_scroll_mode);
+        saved_horizontal_scroll_mode = NULL;
+        scroll_region_enabled = 0;
+    }
+    return 1;
+}
+
+void consoline_get_stats(struct consoline_stats * stats_out)
+{
+    *stats_out = stats;
+    stats_out->pending_output_bytes = pending_output_size();
+}
+
 void consoline_set_leave_entered_lines_on_stdout(char bool_value)
 {
     current_leave_entered_lines_on_stdout = bool_value;
@@ -191,11 +968,18 @@ static void signal_handler(int code)
             if (!ctrl_c_should_propagate_anyway) {
                 // don't do anything non-trivial in a signal handler
                 pending_ctrl_c = 1;
+                if (wake_event_fd != -1) {
+                    uint64_t one = 1;
+                    write(wake_event_fd, &one, sizeof(one));
+                }
                 break;
             }
             // otherwise, fallthrough
         case SIGQUIT:
         case SIGTERM:
+            // don't leave the terminal with only part of it scrolling
+            if (scroll_region_is_set)
+                write(STDOUT_FILENO, scroll_region_reset_sequence, scroll_region_reset_sequence_len);
             // cleanup readline
             rl_cleanup_after_signal();
             // detach this handler and resend to ourselves
@@ -224,34 +1008,63 @@ void consoline_ignore_ctrl_c()
     set_signal_handlers(SIG_IGN);
 }
 
-struct printf_data {
-    const char* fmt;
-    va_list args;
-};
-static void printf_func(void* data)
-{
-    struct printf_data* d = (struct printf_data*)data;
-
-    vprintf(d->fmt, d->args);
-    printf("\n");
-}
 void consoline_printfln(const char* const fmt, ...)
 {
-    struct printf_data d;
-    d.fmt = fmt;
-
-    va_start(d.args, fmt);
-    async_print(printf_func, &d);
-    va_end(d.args);
+    va_list args;
+    va_start(args, fmt);
+    va_list args_copy;
+    va_copy(args_copy, args);
+    int len = vsnprintf(NULL, 0, fmt, args_copy);
+    va_end(args_copy);
+    // vsnprintf needs room for a null terminator, which becomes the newline.
+    if (!is_owner_thread()) {
+        struct queued_output * node = allocate_queued_output(len + 1);
+        vsnprintf(node->text, len + 1, fmt, args);
+        node->text[len] = '\n';
+        push_queued_output(node);
+    } else {
+        char * destination = reserve_line(len + 1);
+        if (destination != NULL) {
+            vsnprintf(destination, len + 1, fmt, args);
+            destination[len] = '\n';
+        }
+        flush_pending_output_if_due();
+    }
+    va_end(args);
 }
 
-static void print_func(void* data)
+void consoline_println(char* line)
 {
-    puts((char *)data);
+    consoline_println_batch(&line, 1);
 }
-void consoline_println(char* line)
+
+void consoline_println_batch(char ** lines, int count)
 {
-    async_print(print_func, line);
+    if (count <= 0)
+        return;
+    if (!is_owner_thread()) {
+        int * lens = (int *)malloc(count * sizeof(int));
+        int len = 0;
+        int i;
+        for (i = 0; i < count; i++) {
+            lens[i] = strlen(lines[i]);
+            len += lens[i] + 1;
+        }
+        struct queued_output * node = allocate_queued_output(len);
+        char * cursor = node->text;
+        for (i = 0; i < count; i++) {
+            memcpy(cursor, lines[i], lens[i]);
+            cursor += lens[i];
+            *cursor++ = '\n';
+        }
+        free(lens);
+        push_queued_output(node);
+        return;
+    }
+    int i;
+    for (i = 0; i < count; i++)
+        queue_line(lines[i], strlen(lines[i]));
+    flush_pending_output_if_due();
 }
 
 struct getpass_data {
@@ -272,6 +1085,7 @@ char* consoline_getpass(const char * prompt)
     data.prompt = prompt;
     char * result;
     data.return_pointer = &result;
+    flush_pending_output();
     remove_line_handler();
     async_print(getpass_func, &data);
     install_line_handler();
@@ -284,15 +1098,52 @@ static char * match_generator(const char * text, int index)
     return current_matches[index];
 }
 
+// set by consoline_set_partial_completion() while the completion handler runs
+static char * partial_completion_prefix = NULL;
+static int partial_completion_match_count = 0;
+// instead of readline's "Display all N possibilities", where N would only count the ones shown
+static void display_partial_matches(char ** matches, int len, int max_len)
+{
+    rl_crlf();
+    fprintf(rl_outstream, "%d possibilities, showing the %d most popular", partial_completion_match_count, len);
+    rl_display_match_list(matches, len, max_len);
+    rl_forced_update_display();
+}
+// readline wants the text to insert first, then the suggestions.
+// it would work out that text from the suggestions, which aren't all of them.
+static char ** partial_completion(char ** matches)
+{
+    int len = 0;
+    while (matches[len] != NULL)
+        len++;
+    char ** results = (char **)malloc((len + 2) * sizeof(char *));
+    results[0] = partial_completion_prefix;
+    partial_completion_prefix = NULL;
+    memcpy(results + 1, matches, (len + 1) * sizeof(char *));
+    free(matches);
+    if (partial_completion_match_count > len)
+        rl_completion_display_matches_hook = display_partial_matches;
+    return results;
+}
+
 static char** attempt_completion(const char *text, int start, int end)
 {
+    // readline might list the matches below the input line
+    reset_scroll_region();
+    free(partial_completion_prefix);
+    partial_completion_prefix = NULL;
+    rl_completion_display_matches_hook = NULL;
     if (current_completion_handler != NULL) {
         // try completion
+        long long start_time = monotonic_nanoseconds();
         char ** matches = current_completion_handler(rl_line_buffer, start, end, text);
+        consoline_histogram_add(&stats.completion_time, monotonic_nanoseconds() - start_time);
         if (matches != NULL) {
             // array of some length given
             if (matches[0] != NULL) {
                 // non-empty array given. we have suggestions
+                if (partial_completion_prefix != NULL && matches[1] != NULL)
+                    return partial_completion(matches);
                 if (current_matches != NULL)
                     free(current_matches);
                 current_matches = matches;
@@ -308,12 +1159,58 @@ static char** attempt_completion(const char *text, int start, int end)
     return NULL;
 }
 
+static void open_wakeups()
+{
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    redraw_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    wake_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_watch(redraw_timer_fd, EPOLLIN);
+    epoll_watch(wake_event_fd, EPOLLIN);
+    epoll_watch(queued_output_event_fd, EPOLLIN);
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = STDIN_FILENO;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, STDIN_FILENO, &event) == 0) {
+        epoll_is_watching_stdin = 1;
+    } else {
+        // a regular file can't be watched, but it's always readable
+        uint64_t one = 1;
+        write(wake_event_fd, &one, sizeof(one));
+    }
+}
+static void close_wakeups()
+{
+    int fds[] = { epoll_fd, redraw_timer_fd, wake_event_fd };
+    epoll_fd = -1;
+    redraw_timer_fd = -1;
+    redraw_timer_is_armed = 0;
+    wake_event_fd = -1;
+    epoll_is_watching_stdin = 0;
+    epoll_is_watching_stdout = 0;
+    int i;
+    for (i = 0; i < sizeof(fds) / sizeof(int); i++)
+        close(fds[i]);
+}
+
 void consoline_init(const char * profile_name, const char * prompt)
 {
     FD_ZERO(&stdin_fd_set);
+    owner_thread = pthread_self();
+    queued_output_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    open_wakeups();
     rl_readline_name = profile_name;
+    // before readline sets up its handlers
+    catch_window_size_changes();
     rl_initialize();
+    // unless ~/.inputrc sets history-size. with no limit at all, every entered line
+    // costs more than the last, which makes pasting lots of lines quadratic.
+    if (!history_is_stifled())
+        stifle_history(DEFAULT_HISTORY_SIZE);
     rl_attempted_completion_function = attempt_completion;
+    rl_getc_function = getc_from_input_buffer;
+    input_buffer_start = 0;
+    input_buffer_len = 0;
     rl_sort_completion_matches = 0;
 
     consoline_set_prompt(prompt);
@@ -336,16 +1233,36 @@ void consoline_set_completion_handler(char** (*completion_handler)(char * line,
 {
     current_completion_handler = completion_handler;
 }
+void consoline_set_partial_completion(const char * common_prefix, int match_count)
+{
+    free(partial_completion_prefix);
+    partial_completion_prefix = strdup(common_prefix);
+    partial_completion_match_count = match_count;
+}
 char * consoline_get_completion_separators()
 {
     return strdup(rl_basic_word_break_characters);
 }
 
+int consoline_get_queued_output_fd()
+{
+    return queued_output_event_fd;
+}
+
+int consoline_get_fd()
+{
+    return epoll_fd;
+}
+
 void consoline_deinit()
 {
+    print_queued_output();
+    flush_pending_output();
+    consoline_set_scroll_region(0);
     rl_set_prompt("");
     rl_replace_line("", 0);
     rl_redisplay();
     remove_line_handler();
+    close_wakeups();
 }
 
@@ -1,20 +1,45 @@
 #ifndef _CONSOLINE_H_
 #define _CONSOLINE_H_
 
+#include <stddef.h>
+
 // NOTE: if you're using any 'interruptible' system calls, like select(), ignore
-// any EINTR errors you get and simply retry the system call. This is a side
-// effect of handling ctrl+c.
+// any EINTR errors you get and simply retry the system call (after calling
+// consoline_poll() if you were waiting for input). This is a side effect of
+// handling ctrl+c.
 
 // call this once before any other functions here. the prompt can be changed later.
+// the other functions must be called from the same thread, except for the print functions.
+// this catches SIGWINCH. a SIGWINCH handler installed after this should call the one it replaced.
 void consoline_init(const char * profile_name, const char * prompt);
 // call this when you're done with these functions. typically, provide this to atexit().
 // this makes sure your terminal is back to normal.
 void consoline_deinit();
-// you must call this frequently. 60Hz seems like a good speed.
+// call this whenever STDIN_FILENO is readable and whenever a blocking wait
+// (like poll()) was interrupted by a signal. calling it more often is harmless.
+// once the eof handler has been called, stdin no longer needs to be watched.
 void consoline_poll();
+// if other threads print, also watch this file descriptor. it becomes readable
+// when they have queued lines for consoline_poll() to print.
+int consoline_get_queued_output_fd();
+// or instead of all of the above, and instead of consoline_get_poll_timeout() and
+// consoline_is_waiting_for_stdout(), watch this one file descriptor for readability,
+// for example with epoll, and call consoline_on_readable() when it's readable.
+// it covers stdin, queued lines, held back output, stdout taking more output, and ctrl+c.
+// it stays quiet while there's nothing to do. each call to consoline_on_readable() consumes
+// whatever made it readable, so it works with level-triggered polling.
+int consoline_get_fd();
+void consoline_on_readable();
+
+// the print functions can be called from any thread.
+// from the thread that called consoline_init(), they print right away.
+// from other threads, they never block. the lines are queued and printed by the next consoline_poll().
 
 // use this instead of printf("%s\n", line).
 void consoline_println(char* line);
+// use this instead of calling consoline_println() on each of several lines.
+// the input line is hidden and redrawn once for the whole batch.
+void consoline_println_batch(char ** lines, int count);
 // use this instead of printf(fmt, ...). need not include a newline.
 void consoline_printfln(const char* const fmt, ...);
 
@@ -30,6 +55,10 @@ void consoline_set_eof_handler(void (*eof_handler)());
 // returning NULL or an empty array indicates no suggestions.
 // results are not sorted.
 void consoline_set_completion_handler(char** (*completion_handler)(char * line, int start, int end, const char * text));
+// a completion handler that only returns some of the suggestions calls this before returning,
+// with the longest prefix all of them share and how many there are.
+// tab then inserts that prefix, rather than what the returned ones happen to share.
+void consoline_set_partial_completion(const char * common_prefix, int match_count);
 // such as " \t\n\"'`@$><=;|&{(".
 // free the return value when you done with it.
 char * consoline_get_completion_separators();
@@ -37,6 +66,69 @@ char * consoline_get_completion_separators();
 // such as ">>> "
 void consoline_set_prompt(const char * prompt);
 
+// limits how many times per second output can interrupt the input line.
+// output printed in between is held back and printed all at once.
+// 0 means no limit, which is the default.
+void consoline_set_max_redraw_hz(int hz);
+// returns the number of milliseconds until held back output needs to be printed,
+// or -1 if there's nothing held back. use this as the timeout while waiting for
+// input, and call consoline_poll() when it expires.
+int consoline_get_poll_timeout();
+
+// output is written to stdout without blocking. whatever stdout won't take yet waits in a buffer.
+// if this returns non-zero, wait for STDOUT_FILENO to be writable too, and call consoline_poll() when it is.
+char consoline_is_waiting_for_stdout();
+
+// keeps the input line on the bottom row of the terminal, and scrolls output above it
+// using a scroll region, so that printing output doesn't have to hide and redraw the input line.
+// the input line scrolls sideways instead of wrapping onto more rows.
+// returns 0 if the terminal can't do that, in which case nothing changes. the default is off.
+char consoline_set_scroll_region(char bool_value);
+
+enum consoline_overflow_policy {
+    // wait for stdout to take everything in the buffer
+    CONSOLINE_OVERFLOW_BLOCK,
+    // forget the oldest lines in the buffer
+    CONSOLINE_OVERFLOW_DROP_OLDEST,
+    // forget the new lines
+    CONSOLINE_OVERFLOW_DROP_NEWEST,
+};
+// what to do when more than bytes of output are waiting for stdout. 0 means no limit.
+// dropped lines are replaced by a line saying how many were dropped.
+// the default is 1MB with CONSOLINE_OVERFLOW_BLOCK.
+void consoline_set_output_buffer_limit(size_t bytes, enum consoline_overflow_policy policy);
+
+// counts durations in power of two buckets. bucket i is for 2^i up to 2^(i+1) nanoseconds.
+#define CONSOLINE_HISTOGRAM_BUCKETS 40
+struct consoline_histogram {
+    unsigned long long count;
+    unsigned long long total_nanoseconds;
+    unsigned long long buckets[CONSOLINE_HISTOGRAM_BUCKETS];
+};
+void consoline_histogram_add(struct consoline_histogram * histogram, long long nanoseconds);
+// estimates the duration that percent of the counted durations were shorter than.
+// returns 0 if nothing has been counted.
+long long consoline_histogram_percentile(const struct consoline_histogram * histogram, double percent);
+
+struct consoline_stats {
+    // how many times stdout couldn't take more output right away
+    unsigned long long stdout_would_block_count;
+    // how many times CONSOLINE_OVERFLOW_BLOCK had to wait for stdout
+    unsigned long long blocked_count;
+    unsigned long long lines_dropped;
+    // how much output is waiting right now
+    size_t pending_output_bytes;
+    // everything given to the print functions, including what was dropped
+    unsigned long long lines_printed;
+    unsigned long long bytes_printed;
+    // hiding the input line, writing output above it, and drawing it again
+    struct consoline_histogram redraw_time;
+    // calls to the completion handler
+    struct consoline_histogram completion_time;
+};
+// counting is cheap enough to always be on. call this from the thread that called consoline_init().
+void consoline_get_stats(struct consoline_stats * stats);
+
 // defaults to 1, which is probably what people are used to
 void consoline_set_leave_entered_lines_on_stdout(char bool_value);
 
@@ -18,6 +18,36 @@ const char const * const usage[] = {
     "            Turn off completion. The default is to complete from a database of",
     "            all words seen so far in the stdout and stdin.",
     "",
+    "    --history-file",
+    "    --history-file=[PATH]",
+    "            Remember the words for completion across sessions in PATH, or in",
+    "            ~/.consoline_history if PATH isn't given. Everything the command",
+    "            outputs gets saved there, so don't use this if that could include",
+    "            secrets. The default is to forget the words when consoline exits.",
+    "",
+    "    --no-history-file",
+    "            Undo --history-file.",
+    "",
+    "    --no-completion-filter",
+    "            Add every word to the completion database. The default is to skip",
+    "            words that look like numbers, hashes, or uuids, and words that",
+    "            have only shown up in the output once. Words you type are always",
+    "            added.",
+    "",
+    "    --completion-reject=[REGEX]",
+    "            Also skip words in the output that match the POSIX extended",
+    "            regular expression REGEX. Can be given more than once.",
+    "",
+    "    --history-max-words=[N]",
+    "            Remember at most N words for completion. When there are too many,",
+    "            the least used words are forgotten. The default is 0, which means",
+    "            no limit.",
+    "",
+    "    --history-max-bytes=[N]",
+    "            Same idea, but limits the memory used by the words to about N",
+    "            bytes. N can end in K, M, or G. The default is 0, which means no",
+    "            limit.",
+    "",
     "    --hide-entered-lines",
     "            After lines are typed, make them disappear instead of staying on",
     "            stdout.",
@@ -25,6 +55,61 @@ const char const * const usage[] = {
     "    --prompt=[PROMPT]",
     "            use prompt PROMPT. Default is \"\".",
     "",
+    "    --max-redraw-hz=[N]",
+    "            Interrupt the input line to print output at most N times per",
+    "            second. Output in between is held back and printed all at once.",
+    "            The default is 0, which means no limit.",
+    "",
+    "    --scroll-region",
+    "            Keep the input line on the bottom row of the terminal, and scroll",
+    "            output above it, so that output never has to redraw the input",
+    "            line. The input line scrolls sideways instead of wrapping. Falls",
+    "            back to redrawing if the terminal can't set a scroll region.",
+    "",
+    "    --output-buffer=[N]",
+    "            Hold at most N bytes of output while the terminal is busy. N can",
+    "            end in K, M, or G. The default is 1M.",
+    "",
+    "    --overflow=[POLICY]",
+    "            What to do when the output buffer is full. POLICY is one of:",
+    "                block        wait for the terminal (the default)",
+    "                drop-oldest  forget the oldest lines in the buffer",
+    "                drop-newest  forget new lines until there's room",
+    "            Dropped lines are replaced by a line saying how many there were.",
+    "",
+    "    --no-passthrough",
+    "            Edit the input line and complete words even when stdout isn't a",
+    "            terminal. The default in that case is to pass everything through",
+    "            unchanged, using splice() where possible, with the command's",
+    "            stderr going straight to ours.",
+    "",
+    "    --separate-stderr",
+    "            Read the command's stderr separately from its stdout, and before",
+    "            it, so that errors show up right away even when there's a lot of",
+    "            other output.",
+    "",
+    "    --stderr-color",
+    "            Same as --separate-stderr, and print the stderr lines in red.",
+    "",
+    "    --pty",
+    "            Give the command a pseudo-terminal for its stdout (and its stderr",
+    "            unless --separate-stderr), so that it line-buffers its output like",
+    "            it would in a terminal, instead of buffering it in big blocks.",
+    "            The command is then in a session of its own, so with -c, consoline",
+    "            passes Ctrl+C along to it.",
+    "",
+    "    --threads",
+    "            Read the command's output on a separate thread, which buffers up",
+    "            to 16MB of it. The command never waits for a slow terminal unless",
+    "            it gets that far ahead.",
+    "",
+    "Signals:",
+    "    SIGUSR1",
+    "            Print what consoline has been up to: how much the command has",
+    "            output, how long redraws and completion take, and how big the",
+    "            completion database is. This goes to stderr when there's no",
+    "            input line.",
+    "",
     "Examples:",
     "    consoline bash -c \"sleep 3; echo hello; bash\"",
     "",
@@ -35,138 +120,407 @@ const char const * const usage[] = {
     "",
 };
 
+#define _GNU_SOURCE
 #include "consoline.h"
 #include "HistoryDatabase.h"
+#include "Tokenizer.h"
+#include "Indexer.h"
+#include "PipeReader.h"
 
 #include <unistd.h>
+#include <fcntl.h>
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
-#include <time.h>
+#include <stdarg.h>
+#include <signal.h>
+#include <poll.h>
 #include <wait.h>
+#include <limits.h>
+#include <pty.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
 
 static int child_pid;
-static int child_stdin_fd;
-static int child_stdout_fd;
-static fd_set child_stdout_fd_set;
+// -1 once it's closed
+static int child_stdin_fd = -1;
+static char stdin_is_open = 1;
+static unsigned long long child_stdin_byte_count = 0;
+// set once there's an input line to print above
+static char line_editing = 0;
+// the signal mask to use while blocked waiting for input.
+static sigset_t waiting_sigmask;
+// used for readline's settings and the default history file.
+#define PROFILE_NAME "consoline"
+
 static char use_completion = 1;
 static HistoryDatabase * history_database;
 static char handle_ctrl_c = 1;
 
-static char is_seperator_char[256];
-static void init_seperator_chars()
+static Tokenizer * tokenizer;
+// keeps one-off noise out of history_database. NULL if turned off.
+static AdmissionFilter * admission_filter;
+// splits words and adds them to history_database in the background.
+static Indexer * indexer;
+// lines can be separated by null characters.
+// typed is non-zero for what the user typed, which is always worth remembering.
+static void register_words(const char * lines, int len, char typed)
 {
-    char * seperator_chars = consoline_get_completion_separators();
-    int i;
-    for (i = 0; seperator_chars[i] != '\0'; i++)
-        is_seperator_char[(int)seperator_chars[i]] = 1;
-    free(seperator_chars);
+    if (!use_completion)
+        return;
+    Indexer_add_text(indexer, lines, len, typed);
 }
-static char ** split(char * string)
+static void open_history_database(const char * history_file)
 {
-    int result_cap = 0x10;
-    char ** result = (char **)malloc(result_cap * sizeof(char *));
-    int result_size = 0;
-
-    int word_start = 0;
-    int i;
-    for (i = 0; ; i++) {
-        if (is_seperator_char[(int)string[i]] || string[i] == '\0') {
-            // end of a word
-            int word_len = i - word_start;
-            if (word_len != 0) {
-                result[result_size++] = strndup(&string[word_start], word_len);
-                if (result_size == result_cap) {
-                    result_cap *= 2;
-                    result = (char **)realloc(result, result_cap * sizeof(char *));
-                }
-            }
-            word_start = i + 1;
+    char * default_history_file = NULL;
+    if (history_file == NULL) {
+        const char * home = getenv("HOME");
+        if (home != NULL) {
+            int len = strlen(home) + strlen("/." PROFILE_NAME "_history") + 1;
+            default_history_file = (char *)malloc(len);
+            snprintf(default_history_file, len, "%s/.%s_history", home, PROFILE_NAME);
+            history_file = default_history_file;
         }
-        if (string[i] == '\0')
-            break;
     }
-    result[result_size] = NULL;
-    return result;
+    if (history_file != NULL)
+        history_database = HistoryDatabase_open(history_file, 0);
+    // fall back to remembering things just for this session
+    if (history_database == NULL)
+        history_database = HistoryDatabase_create(0);
+    free(default_history_file);
 }
-static void register_words(char * line)
+static void close_history_database()
 {
-    if (!use_completion)
-        return;
-    char ** words = split(line);
-    int i;
-    for (i = 0; words[i] != NULL; i++) {
-        HistoryDatabase_add(history_database, words[i]);
-        free(words[i]);
-    }
-    free(words);
+    // finish indexing first
+    Indexer_delete(indexer);
+    HistoryDatabase_delete(history_database);
+    Tokenizer_delete(tokenizer);
+    if (admission_filter != NULL)
+        AdmissionFilter_delete(admission_filter);
 }
+// only this many suggestions are listed, the most popular ones.
+// tab still inserts whatever all the matches start with.
+#define MAX_COMPLETION_SUGGESTIONS 100
 static char ** completion_handler(char * line, int start, int end, const char * text)
 {
-    return HistoryDatabase_prefix_matches(history_database, (char *)text);
+    int match_count;
+    Indexer_lock_database(indexer);
+    char ** matches = HistoryDatabase_prefix_top_k(history_database, (char *)text, MAX_COMPLETION_SUGGESTIONS, &match_count);
+    int common_prefix_len = HistoryDatabase_common_prefix_len(history_database, (char *)text);
+    Indexer_unlock_database(indexer);
+    if (match_count > 1) {
+        // what was typed, then the rest in the case of the most popular match
+        int text_len = strlen(text);
+        char * common_prefix = (char *)malloc(common_prefix_len + 1);
+        memcpy(common_prefix, text, text_len);
+        memcpy(common_prefix + text_len, matches[0] + text_len, common_prefix_len - text_len);
+        common_prefix[common_prefix_len] = '\0';
+        consoline_set_partial_completion(common_prefix, match_count);
+        free(common_prefix);
+    }
+    return matches;
 }
 
 
-static void eof_handler()
+// entered lines wait here until the child takes them. writing to the child never blocks,
+// because the child might be busy, or blocked writing output that only we can read.
+static char * child_stdin_queue = NULL;
+static int child_stdin_queue_start = 0;
+static int child_stdin_queue_len = 0;
+static int child_stdin_queue_capacity = 0;
+// past this, entered lines are dropped until the child catches up
+#define CHILD_STDIN_QUEUE_LIMIT 0x1000000
+static unsigned long long child_stdin_bytes_dropped = 0;
+// set while dropping, so that it's only reported once
+static char child_stdin_is_dropping = 0;
+
+static int child_stdin_queue_size()
+{
+    return child_stdin_queue_len - child_stdin_queue_start;
+}
+static void close_child_stdin()
 {
+    if (child_stdin_fd == -1)
+        return;
     close(child_stdin_fd);
+    child_stdin_fd = -1;
+    child_stdin_bytes_dropped += child_stdin_queue_size();
+    child_stdin_queue_start = 0;
+    child_stdin_queue_len = 0;
+}
+// writes as much of the queue as the child will take right now.
+// whatever was entered goes in one write, however many lines that is.
+// returns non-zero if the child isn't reading its stdin anymore.
+static char write_child_stdin_queue()
+{
+    while (child_stdin_queue_size() > 0) {
+        ssize_t count = write(child_stdin_fd, child_stdin_queue + child_stdin_queue_start, child_stdin_queue_size());
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN)
+                return 0;
+            // the child isn't reading its stdin anymore
+            char is_broken_pipe = errno == EPIPE;
+            close_child_stdin();
+            return is_broken_pipe;
+        }
+        child_stdin_queue_start += count;
+        child_stdin_byte_count += count;
+    }
+    child_stdin_queue_start = 0;
+    child_stdin_queue_len = 0;
+    child_stdin_is_dropping = 0;
+    // the end of our stdin waited for the child to take everything before it
+    if (!stdin_is_open)
+        close_child_stdin();
+    return 0;
+}
+static void flush_child_stdin_queue()
+{
+    // a child that stopped reading its stdin shows up as EPIPE, and the SIGPIPE that comes with it
+    // is held off and taken here. it's only held off here, so that our own stdout going away still ends us.
+    sigset_t sigpipe_set;
+    sigemptyset(&sigpipe_set);
+    sigaddset(&sigpipe_set, SIGPIPE);
+    sigset_t old_mask;
+    sigprocmask(SIG_BLOCK, &sigpipe_set, &old_mask);
+    if (write_child_stdin_queue()) {
+        struct timespec no_wait = { 0, 0 };
+        sigtimedwait(&sigpipe_set, NULL, &no_wait);
+    }
+    sigprocmask(SIG_SETMASK, &old_mask, NULL);
+}
+
+static void eof_handler()
+{
+    stdin_is_open = 0;
+    if (child_stdin_queue_size() == 0)
+        close_child_stdin();
 }
 static void line_handler(char * line)
 {
-    write(child_stdin_fd, line, strlen(line));
-    static char newline_char = '\n';
-    write(child_stdin_fd, &newline_char, 1);
-    register_words(line);
+    int len = strlen(line);
+    register_words(line, len, 1);
+    if (child_stdin_fd == -1) {
+        child_stdin_bytes_dropped += len + 1;
+        return;
+    }
+    if (child_stdin_queue_size() + len + 1 > CHILD_STDIN_QUEUE_LIMIT) {
+        if (!child_stdin_is_dropping)
+            consoline_printfln("[consoline] the command isn't reading its input. dropping input until it does.");
+        child_stdin_is_dropping = 1;
+        child_stdin_bytes_dropped += len + 1;
+        return;
+    }
+    if (child_stdin_queue_len + len + 1 > child_stdin_queue_capacity) {
+        // move what's left to the front first
+        memmove(child_stdin_queue, child_stdin_queue + child_stdin_queue_start, child_stdin_queue_size());
+        child_stdin_queue_len -= child_stdin_queue_start;
+        child_stdin_queue_start = 0;
+    }
+    if (child_stdin_queue_len + len + 1 > child_stdin_queue_capacity) {
+        child_stdin_queue_capacity = child_stdin_queue_capacity == 0 ? 0x1000 : child_stdin_queue_capacity * 2;
+        if (child_stdin_queue_capacity < child_stdin_queue_len + len + 1)
+            child_stdin_queue_capacity = child_stdin_queue_len + len + 1;
+        child_stdin_queue = (char *)realloc(child_stdin_queue, child_stdin_queue_capacity * sizeof(char));
+    }
+    // the main loop writes it, after everything else that came in with it
+    memcpy(child_stdin_queue + child_stdin_queue_len, line, len);
+    child_stdin_queue[child_stdin_queue_len + len] = '\n';
+    child_stdin_queue_len += len + 1;
 }
 
-static void poll_subprocess()
+// how much to ask for per read(). this is the default size of a pipe buffer on linux.
+#define CHILD_READ_SIZE 0x10000
+// with --threads, how much the child can get ahead of the terminal
+#define CHILD_OUTPUT_BUFFER_SIZE 0x1000000
+
+// how many times to read the child's stderr for every read of its stdout
+#define STDERR_READS_PER_POLL 4
+#define STDERR_COLOR "\033[31m"
+#define COLOR_RESET "\033[0m"
+
+// one of the child's output streams, split into lines
+typedef struct {
+    int fd;
+    // with --threads, this reads fd. otherwise NULL.
+    PipeReader * reader;
+    char is_open;
+    // wrapped around each line. NULL for none.
+    const char * color;
+    // holds a partial line from the previous read followed by the new data.
+    char * line_buffer;
+    int line_buffer_len;
+    int line_buffer_capacity;
+    // the complete lines found in line_buffer
+    char ** lines;
+    int lines_capacity;
+    // with a color, the lines are copied here with the color around them
+    char * colored_buffer;
+    size_t colored_buffer_capacity;
+    char ** colored_lines;
+    int colored_lines_capacity;
+    unsigned long long line_count;
+    unsigned long long byte_count;
+} ChildStream;
+static ChildStream child_stdout;
+// only open with --separate-stderr. otherwise stderr goes to child_stdout.
+static ChildStream child_stderr;
+static char separate_stderr = 0;
+static char color_stderr = 0;
+// with --pty, the child's stdout is a pseudo-terminal, and this is our end of it. otherwise -1.
+static int child_pty_fd = -1;
+static char use_pty = 0;
+
+static void open_child_stream(ChildStream * stream, int fd, char use_threads, const char * color)
+{
+    memset(stream, 0, sizeof(ChildStream));
+    stream->fd = fd;
+    stream->is_open = 1;
+    stream->color = color;
+    if (use_threads) {
+        // don't let a slow terminal slow down the child
+        stream->reader = PipeReader_create(fd, CHILD_OUTPUT_BUFFER_SIZE);
+    } else {
+        // poll_subprocess() must never block
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+}
+// what to wait on for the stream to have something to read
+static int get_child_stream_poll_fd(ChildStream * stream)
 {
-    static int line_buffer_capacity = 0x100;
-    static char * line_buffer = NULL;
-    static int line_buffer_cursor = 0;
+    return stream->reader != NULL ? PipeReader_get_event_fd(stream->reader) : stream->fd;
+}
 
-    struct timeval no_time;
-    memset(&no_time, 0, sizeof(no_time));
+static void exit_with_child_status()
+{
+    if (child_stdout.reader != NULL)
+        PipeReader_delete(child_stdout.reader);
+    if (child_stderr.reader != NULL)
+        PipeReader_delete(child_stderr.reader);
+    int status;
+    waitpid(child_pid, &status, 0);
+    exit(WEXITSTATUS(status));
+}
 
-    for (;;) {
-        FD_SET(child_stdout_fd, &child_stdout_fd_set);
-        int ready_count = select(FD_SETSIZE, &child_stdout_fd_set, NULL, NULL, &no_time);
-        if (ready_count < 0) {
-            if (errno == EINTR)
-                continue;
+static void print_child_lines(ChildStream * stream, char ** lines, int count)
+{
+    if (stream->color == NULL) {
+        consoline_println_batch(lines, count);
+        return;
+    }
+    // still one batch, so that the input line is only redrawn once
+    size_t color_len = strlen(stream->color);
+    size_t size = 0;
+    int i;
+    for (i = 0; i < count; i++)
+        size += color_len + strlen(lines[i]) + strlen(COLOR_RESET) + 1;
+    if (size > stream->colored_buffer_capacity) {
+        stream->colored_buffer_capacity = size * 2;
+        stream->colored_buffer = (char *)realloc(stream->colored_buffer, stream->colored_buffer_capacity * sizeof(char));
+    }
+    if (count > stream->colored_lines_capacity) {
+        stream->colored_lines_capacity = count * 2;
+        stream->colored_lines = (char **)realloc(stream->colored_lines, stream->colored_lines_capacity * sizeof(char *));
+    }
+    char * cursor = stream->colored_buffer;
+    for (i = 0; i < count; i++) {
+        stream->colored_lines[i] = cursor;
+        size_t len = strlen(lines[i]);
+        memcpy(cursor, stream->color, color_len);
+        cursor += color_len;
+        memcpy(cursor, lines[i], len);
+        cursor += len;
+        memcpy(cursor, COLOR_RESET, strlen(COLOR_RESET) + 1);
+        cursor += strlen(COLOR_RESET) + 1;
+    }
+    consoline_println_batch(stream->colored_lines, count);
+}
+
+// reads whatever the child has written so far and prints the complete lines.
+// returns non-zero if there was anything to read.
+static char read_child_stream(ChildStream * stream)
+{
+    // expand buffer if needed. the extra byte is room for a null terminator.
+    if (stream->line_buffer_capacity - stream->line_buffer_len < CHILD_READ_SIZE + 1) {
+        stream->line_buffer_capacity = stream->line_buffer_len + CHILD_READ_SIZE + 1;
+        stream->line_buffer = (char *)realloc(stream->line_buffer, stream->line_buffer_capacity * sizeof(char));
+    }
+    char * read_destination = stream->line_buffer + stream->line_buffer_len;
+    int read_count;
+    if (stream->reader != NULL)
+        read_count = PipeReader_read(stream->reader, read_destination, CHILD_READ_SIZE);
+    else
+        read_count = read(stream->fd, read_destination, CHILD_READ_SIZE);
+    if (read_count < 0) {
+        if (errno == EINTR || errno == EAGAIN)
+            return 0;
+        // a pseudo-terminal says this once the child has closed it
+        if (errno != EIO)
             exit(1);
-        } else if (ready_count == 0) {
-            return;
-        }
-        // read a character
-        char c;
-        int read_count = read(child_stdout_fd, &c, 1);
-        if (read_count == 0) {
-            // stdout has been closed. wait and terminate with child's exit code.
-            int status;
-            waitpid(child_pid, &status, 0);
-            exit(WEXITSTATUS(status));
-        }
-        // expand buffer if needed
-        if (line_buffer == NULL || !(line_buffer_cursor + 1 < line_buffer_capacity)) {
-            line_buffer_capacity *= 2;
-            line_buffer = (char *)realloc(line_buffer, line_buffer_capacity * sizeof(char));
+        read_count = 0;
+    }
+    if (read_count == 0) {
+        // the stream has been closed. flush anything left without a newline.
+        if (stream->line_buffer_len != 0) {
+            stream->line_buffer[stream->line_buffer_len] = '\0';
+            print_child_lines(stream, &stream->line_buffer, 1);
+            register_words(stream->line_buffer, stream->line_buffer_len, 0);
+            stream->line_count++;
         }
-        if (c != '\n') {
-            // buffer the char
-            line_buffer[line_buffer_cursor++] = c;
-        } else {
-            // flush line buffer. don't include newline.
-            line_buffer[line_buffer_cursor] = '\0';
-            consoline_println(line_buffer);
-            register_words(line_buffer);
-            line_buffer_cursor = 0;
+        stream->is_open = 0;
+        return 0;
+    }
+    stream->byte_count += read_count;
+    // only the new data can contain newlines.
+    char * line_start = stream->line_buffer;
+    char * scan_start = read_destination;
+    char * buffer_end = scan_start + read_count;
+    char * newline;
+    int lines_len = 0;
+    while ((newline = (char *)memchr(scan_start, '\n', buffer_end - scan_start)) != NULL) {
+        // terminate the line. don't include newline.
+        *newline = '\0';
+        if (lines_len == stream->lines_capacity) {
+            stream->lines_capacity = stream->lines_capacity == 0 ? 0x100 : stream->lines_capacity * 2;
+            stream->lines = (char **)realloc(stream->lines, stream->lines_capacity * sizeof(char *));
         }
+        stream->lines[lines_len++] = line_start;
+        line_start = newline + 1;
+        scan_start = line_start;
     }
+    stream->line_count += lines_len;
+    // print all the complete lines at once
+    print_child_lines(stream, stream->lines, lines_len);
+    // all the complete lines at once, too
+    register_words(stream->line_buffer, line_start - stream->line_buffer, 0);
+    // keep the partial line for next time
+    stream->line_buffer_len = buffer_end - line_start;
+    memmove(stream->line_buffer, line_start, stream->line_buffer_len);
+    return 1;
+}
+
+static void poll_subprocess()
+{
+    // errors first, so that they don't wait behind a flood of regular output.
+    // only read stdout once, so that a flood of output can't starve the terminal input.
+    int i;
+    for (i = 0; i < STDERR_READS_PER_POLL && child_stderr.is_open; i++)
+        if (!read_child_stream(&child_stderr))
+            break;
+    if (child_stdout.is_open)
+        read_child_stream(&child_stdout);
+    // then wait and terminate with child's exit code.
+    if (!child_stdout.is_open && !child_stderr.is_open)
+        exit_with_child_status();
 }
 
-static void launch_child_process(char ** child_argv)
+// with pipe_stderr, the child's stderr gets its own pipe, read into child_stderr.
+// otherwise it goes wherever ours does if separate_stderr is set, or to the stdout pipe if not.
+static void launch_child_process(char ** child_argv, char use_threads, char pipe_stderr)
 {
     int child_stdin_pipe[2];
     if (pipe(child_stdin_pipe) == -1)
@@ -174,19 +528,51 @@ static void launch_child_process(char ** child_argv)
     int child_stdout_pipe[2];
     if (pipe(child_stdout_pipe) == -1)
         exit(1);
+    int child_stderr_pipe[2];
+    if (pipe_stderr && pipe(child_stderr_pipe) == -1)
+        exit(1);
+    if (use_pty) {
+        // programs only line-buffer their output when it looks like a terminal.
+        int child_pty_slave_fd;
+        struct winsize window_size;
+        char have_window_size = ioctl(STDIN_FILENO, TIOCGWINSZ, &window_size) == 0;
+        if (openpty(&child_pty_fd, &child_pty_slave_fd, NULL, NULL, have_window_size ? &window_size : NULL) == -1)
+            exit(1);
+        // leave newlines alone. we're not a terminal, we're just relaying the output.
+        struct termios settings;
+        tcgetattr(child_pty_slave_fd, &settings);
+        settings.c_oflag &= ~OPOST;
+        tcsetattr(child_pty_slave_fd, TCSANOW, &settings);
+        // the slave end goes where the stdout pipe would have
+        close(child_stdout_pipe[0]);
+        child_stdout_pipe[0] = child_pty_fd;
+        child_stdout_pipe[1] = child_pty_slave_fd;
+    }
     child_pid = fork();
     if (child_pid < 0) {
         exit(1);
     } else if (child_pid == 0) {
         // child
+        if (use_pty) {
+            // make the pseudo-terminal our controlling terminal, so that it can tell us about window size changes
+            setsid();
+            ioctl(child_stdout_pipe[1], TIOCSCTTY, 0);
+        }
         dup2(child_stdin_pipe[0], STDIN_FILENO);
         dup2(child_stdout_pipe[1], STDOUT_FILENO);
-        dup2(child_stdout_pipe[1], STDERR_FILENO);
+        if (pipe_stderr)
+            dup2(child_stderr_pipe[1], STDERR_FILENO);
+        else if (!separate_stderr)
+            dup2(child_stdout_pipe[1], STDERR_FILENO);
         // child doesn't need any of these
         close(child_stdin_pipe[0]);
         close(child_stdin_pipe[1]);
         close(child_stdout_pipe[0]);
         close(child_stdout_pipe[1]);
+        if (pipe_stderr) {
+            close(child_stderr_pipe[0]);
+            close(child_stderr_pipe[1]);
+        }
         if (handle_ctrl_c)
             consoline_ignore_ctrl_c();
         // exec
@@ -198,9 +584,324 @@ static void launch_child_process(char ** child_argv)
     // parent
     close(child_stdin_pipe[0]);
     child_stdin_fd = child_stdin_pipe[1];
-    child_stdout_fd = child_stdout_pipe[0];
     close(child_stdout_pipe[1]);
-    FD_ZERO(&child_stdout_fd_set);
+    open_child_stream(&child_stdout, child_stdout_pipe[0], use_threads, NULL);
+    if (pipe_stderr) {
+        close(child_stderr_pipe[1]);
+        open_child_stream(&child_stderr, child_stderr_pipe[0], use_threads, color_stderr ? STDERR_COLOR : NULL);
+    }
+}
+
+// SIGUSR1 asks for a report. it's printed the next time around the main loop.
+static volatile sig_atomic_t stats_requested = 0;
+static void sigusr1_handler(int code)
+{
+    stats_requested = 1;
+}
+static void report_stats_on_sigusr1()
+{
+    struct sigaction action;
+    action.sa_handler = sigusr1_handler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &action, NULL);
+}
+
+static void print_stats_line(const char * fmt, ...)
+{
+    char line[256];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if (line_editing)
+        consoline_println(line);
+    else
+        fprintf(stderr, "%s\n", line);
+}
+static void print_histogram(const char * name, const struct consoline_histogram * histogram)
+{
+    if (histogram->count == 0) {
+        print_stats_line("[consoline] %s: none", name);
+        return;
+    }
+    print_stats_line("[consoline] %s: %llu, mean %lldns, p50 <%lldns, p99 <%lldns, max <%lldns", name,
+            histogram->count, (long long)(histogram->total_nanoseconds / histogram->count),
+            consoline_histogram_percentile(histogram, 50),
+            consoline_histogram_percentile(histogram, 99),
+            consoline_histogram_percentile(histogram, 100));
+}
+static void print_child_stream_stats(const char * name, ChildStream * stream)
+{
+    // passthrough doesn't look for lines
+    if (line_editing)
+        print_stats_line("[consoline] %s: %llu bytes, %llu lines", name, stream->byte_count, stream->line_count);
+    else
+        print_stats_line("[consoline] %s: %llu bytes", name, stream->byte_count);
+    if (stream->reader != NULL)
+        print_stats_line("[consoline] %s buffer filled up: %llu times", name, PipeReader_get_times_full(stream->reader));
+}
+static void print_stats()
+{
+    stats_requested = 0;
+    print_child_stream_stats("child stdout", &child_stdout);
+    // in passthrough, stderr goes straight to ours
+    if (line_editing && separate_stderr)
+        print_child_stream_stats("child stderr", &child_stderr);
+    print_stats_line("[consoline] child stdin: %llu bytes, %d bytes waiting, %llu bytes dropped",
+            child_stdin_byte_count, child_stdin_queue_size(), child_stdin_bytes_dropped);
+    if (line_editing) {
+        struct consoline_stats stats;
+        consoline_get_stats(&stats);
+        print_stats_line("[consoline] printed: %llu lines, %llu bytes, %llu dropped, %zu bytes waiting",
+                stats.lines_printed, stats.bytes_printed, stats.lines_dropped, stats.pending_output_bytes);
+        print_stats_line("[consoline] stdout would have blocked: %llu times, blocked: %llu times",
+                stats.stdout_would_block_count, stats.blocked_count);
+        print_histogram("redraws", &stats.redraw_time);
+        print_histogram("completions", &stats.completion_time);
+    }
+    if (line_editing && use_completion) {
+        IndexerStats indexer_stats;
+        Indexer_get_stats(indexer, &indexer_stats);
+        print_stats_line("[consoline] indexed: %llu words, %llu rejected, %llu texts (%llu bytes) dropped",
+                indexer_stats.words_added, indexer_stats.words_rejected,
+                indexer_stats.texts_dropped, indexer_stats.bytes_dropped);
+        print_histogram("word adds (sampled)", &indexer_stats.add_time);
+        Indexer_lock_database(indexer);
+        int word_count = HistoryDatabase_get_word_count(history_database);
+        size_t memory_used = HistoryDatabase_get_memory_used(history_database);
+        Indexer_unlock_database(indexer);
+        print_stats_line("[consoline] completion database: %d words, %zu bytes", word_count, memory_used);
+    }
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        print_stats_line("[consoline] max resident memory: %ld KB", usage.ru_maxrss);
+}
+
+// how much to move at a time when relaying without line editing
+#define RELAY_SIZE 0x10000
+// cleared once splice() turns out not to work with these file descriptors
+static char can_splice_child_stdout = 1;
+static char can_splice_stdin = 1;
+
+// moves up to len bytes from one file descriptor to another. returns like read().
+// splice() moves the data without copying it through here, but it only works
+// if one side is a pipe and the other side supports it. if not, fall back to read() and write().
+static ssize_t relay(int from_fd, int to_fd, size_t len, char * can_splice, unsigned int splice_flags)
+{
+    static char * buffer = NULL;
+    if (*can_splice) {
+        ssize_t count = splice(from_fd, NULL, to_fd, NULL, len, SPLICE_F_MOVE | splice_flags);
+        if (count >= 0 || errno != EINVAL)
+            return count;
+        *can_splice = 0;
+    }
+    if (buffer == NULL)
+        buffer = (char *)malloc(RELAY_SIZE);
+    ssize_t count = read(from_fd, buffer, len < RELAY_SIZE ? len : RELAY_SIZE);
+    ssize_t written = 0;
+    while (written < count) {
+        ssize_t write_count = write(to_fd, buffer + written, count - written);
+        if (write_count < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN) {
+                // only possible for a non-blocking stdout that someone else set up
+                struct pollfd to_poll = { to_fd, POLLOUT, 0 };
+                poll(&to_poll, 1, -1);
+                continue;
+            }
+            return -1;
+        }
+        written += write_count;
+    }
+    return count;
+}
+
+// when nobody is typing at a terminal, or nobody is looking at one, there's no input line
+// to protect and nobody to complete words for. just move the bytes along.
+static void relay_without_line_editing(char ** child_argv)
+{
+    // the child's stderr goes straight to ours instead of into its stdout,
+    // so that errors still show up on the terminal when our stdout is redirected
+    separate_stderr = 1;
+    launch_child_process(child_argv, 0, 0);
+    // the child can exit before our stdin ends. splice() raises SIGPIPE for that even with nothing to move.
+    signal(SIGPIPE, SIG_IGN);
+    // like block_signals_outside_of_waiting()
+    sigset_t blocked;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGUSR1);
+    sigprocmask(SIG_BLOCK, &blocked, &waiting_sigmask);
+    int child_stdout_fd = child_stdout.fd;
+    // blocking on our stdout is fine. the child would block on it too without us.
+    fcntl(child_stdout_fd, F_SETFL, fcntl(child_stdout_fd, F_GETFL) & ~O_NONBLOCK);
+    // never block writing to the child, in case it's blocked writing to us.
+    // while this is set, wait for the child to take more instead of reading stdin.
+    char child_stdin_is_full = 0;
+    for (;;) {
+        if (stats_requested)
+            print_stats();
+        struct pollfd poll_fds[2];
+        poll_fds[0].fd = child_stdout_fd;
+        poll_fds[0].events = POLLIN;
+        poll_fds[1].fd = child_stdin_is_full ? child_stdin_fd : STDIN_FILENO;
+        poll_fds[1].events = child_stdin_is_full ? POLLOUT : POLLIN;
+        int poll_fds_count = stdin_is_open ? 2 : 1;
+        if (ppoll(poll_fds, poll_fds_count, NULL, &waiting_sigmask) < 0) {
+            if (errno == EINTR)
+                continue;
+            exit(1);
+        }
+        if (poll_fds[0].revents) {
+            ssize_t count = relay(child_stdout_fd, STDOUT_FILENO, RELAY_SIZE, &can_splice_child_stdout, 0);
+            if (count > 0)
+                child_stdout.byte_count += count;
+            if (count < 0 && errno == EAGAIN) {
+                // only possible for a non-blocking stdout that someone else set up
+                struct pollfd stdout_poll = { STDOUT_FILENO, POLLOUT, 0 };
+                poll(&stdout_poll, 1, -1);
+            } else if (count < 0 && errno == EPIPE) {
+                // nobody is reading our stdout anymore. go away like we would have without ignoring SIGPIPE.
+                signal(SIGPIPE, SIG_DFL);
+                raise(SIGPIPE);
+            } else if (count == 0 || (count < 0 && errno != EINTR)) {
+                exit_with_child_status();
+            }
+        }
+        if (poll_fds_count < 2 || !poll_fds[1].revents)
+            continue;
+        if (child_stdin_is_full) {
+            // the child not reading its stdin anymore is like the end of our stdin
+            if (poll_fds[1].revents & POLLERR)
+                eof_handler();
+            child_stdin_is_full = 0;
+            continue;
+        }
+        size_t len = RELAY_SIZE;
+        if (!can_splice_stdin) {
+            // a writable pipe has room for at least PIPE_BUF bytes
+            struct pollfd child_stdin_poll = { child_stdin_fd, POLLOUT, 0 };
+            if (poll(&child_stdin_poll, 1, 0) == 0) {
+                child_stdin_is_full = 1;
+                continue;
+            }
+            len = PIPE_BUF;
+        }
+        // don't block on a full pipe
+        ssize_t count = relay(STDIN_FILENO, child_stdin_fd, len, &can_splice_stdin, SPLICE_F_NONBLOCK);
+        if (count > 0)
+            child_stdin_byte_count += count;
+        if (count < 0 && errno == EAGAIN)
+            child_stdin_is_full = 1;
+        else if (count == 0 || (count < 0 && errno != EINTR))
+            eof_handler();
+    }
+}
+
+// with --pty, the child's window size follows ours.
+static volatile sig_atomic_t window_size_changed = 0;
+// consoline's handler, which still needs to know
+static struct sigaction next_sigwinch_action;
+static void sigwinch_handler(int code)
+{
+    window_size_changed = 1;
+    if (next_sigwinch_action.sa_handler != SIG_DFL && next_sigwinch_action.sa_handler != SIG_IGN)
+        next_sigwinch_action.sa_handler(code);
+}
+static void forward_window_size_changes()
+{
+    struct sigaction action;
+    action.sa_handler = sigwinch_handler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGWINCH, &action, &next_sigwinch_action);
+}
+// with --pty, the child is in a session of its own, so ctrl+c on our terminal doesn't reach it.
+// with -c, pass it along to whatever is in the foreground of the child's terminal,
+// the way it would have reached the child without --pty.
+static struct sigaction next_sigint_action;
+static void sigint_handler(int code)
+{
+    pid_t foreground_group = tcgetpgrp(child_pty_fd);
+    kill(foreground_group > 0 ? -foreground_group : -child_pid, SIGINT);
+    if (next_sigint_action.sa_handler == SIG_IGN)
+        return;
+    if (next_sigint_action.sa_handler != SIG_DFL) {
+        next_sigint_action.sa_handler(code);
+        return;
+    }
+    // then go away like we would have anyway
+    signal(SIGINT, SIG_DFL);
+    raise(SIGINT);
+}
+static void forward_ctrl_c()
+{
+    struct sigaction action;
+    action.sa_handler = sigint_handler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGINT, &action, &next_sigint_action);
+}
+static void forward_window_size_if_changed()
+{
+    if (!window_size_changed)
+        return;
+    window_size_changed = 0;
+    struct winsize window_size;
+    if (ioctl(STDIN_FILENO, TIOCGWINSZ, &window_size) == 0)
+        ioctl(child_pty_fd, TIOCSWINSZ, &window_size);
+}
+
+// ctrl+c is handled by setting a flag that consoline_poll() looks at.
+// keep SIGINT blocked except while we're waiting, so that it can't arrive
+// just after consoline_poll() returns and then go unnoticed until the next event.
+// the same goes for window size changes and requests for stats.
+static void block_signals_outside_of_waiting()
+{
+    sigset_t blocked;
+    sigemptyset(&blocked);
+    if (handle_ctrl_c)
+        sigaddset(&blocked, SIGINT);
+    if (child_pty_fd != -1)
+        sigaddset(&blocked, SIGWINCH);
+    sigaddset(&blocked, SIGUSR1);
+    sigprocmask(SIG_BLOCK, &blocked, &waiting_sigmask);
+}
+
+// blocks until consoline or the child has something to do, or a signal is caught.
+// returns non-zero if consoline_on_readable() should be called.
+static char wait_for_events()
+{
+    struct pollfd poll_fds[4];
+    int poll_fds_count = 0;
+    // the terminal, and the timing of held back output
+    poll_fds[poll_fds_count].fd = consoline_get_fd();
+    poll_fds[poll_fds_count].events = POLLIN;
+    poll_fds_count++;
+    if (child_stdout.is_open) {
+        poll_fds[poll_fds_count].fd = get_child_stream_poll_fd(&child_stdout);
+        poll_fds[poll_fds_count].events = POLLIN;
+        poll_fds_count++;
+    }
+    if (child_stderr.is_open) {
+        poll_fds[poll_fds_count].fd = get_child_stream_poll_fd(&child_stderr);
+        poll_fds[poll_fds_count].events = POLLIN;
+        poll_fds_count++;
+    }
+    // entered lines the child hasn't taken yet
+    if (child_stdin_queue_size() > 0) {
+        poll_fds[poll_fds_count].fd = child_stdin_fd;
+        poll_fds[poll_fds_count].events = POLLOUT;
+        poll_fds_count++;
+    }
+    if (ppoll(poll_fds, poll_fds_count, NULL, &waiting_sigmask) < 0) {
+        if (errno != EINTR)
+            exit(1);
+        // the signal might have been ctrl+c
+        return 1;
+    }
+    return poll_fds[0].revents != 0;
 }
 
 static void print_usage_and_exit()
@@ -210,11 +911,87 @@ static void print_usage_and_exit()
         puts(usage[i]);
     exit(1);
 }
+
+// options that don't do anything without line editing
+static const char * const line_editing_options[] = {
+    "--prompt=",
+    "--hide-entered-lines",
+    "--max-redraw-hz=",
+    "--scroll-region",
+    "--stderr-color",
+    "--threads",
+    "--output-buffer=",
+    "--overflow=",
+};
+static void warn_about_line_editing_options(char ** options, int options_len)
+{
+    int i;
+    for (i = 0; i < options_len; i++) {
+        int j;
+        for (j = 0; j < sizeof(line_editing_options) / sizeof(char *); j++) {
+            const char * option = line_editing_options[j];
+            char is_prefix = option[strlen(option) - 1] == '=';
+            if (is_prefix ? strncmp(options[i], option, strlen(option)) == 0 : strcmp(options[i], option) == 0) {
+                fprintf(stderr, "consoline: stdout isn't a terminal, so %s does nothing. "
+                        "use --no-passthrough to keep it.\n", options[i]);
+                break;
+            }
+        }
+    }
+}
+
+// understands suffixes like 64K and 1G. anything else is a mistake, rather than a 0 that means no limit.
+static size_t parse_size(const char * text)
+{
+    char * suffix;
+    size_t size = strtoull(text, &suffix, 10);
+    char * end = suffix;
+    switch (*suffix) {
+        case 'g': case 'G': size <<= 10;
+            // fall through
+        case 'm': case 'M': size <<= 10;
+            // fall through
+        case 'k': case 'K': size <<= 10;
+            end++;
+    }
+    if (suffix == text || *end != '\0' || text[0] == '-') {
+        fprintf(stderr, "invalid size: %s\n\n", text);
+        print_usage_and_exit();
+    }
+    return size;
+}
+// same idea, for a plain number
+static int parse_count(const char * text)
+{
+    char * end;
+    errno = 0;
+    long count = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || count < 0 || count > INT_MAX || errno != 0) {
+        fprintf(stderr, "invalid number: %s\n\n", text);
+        print_usage_and_exit();
+    }
+    return count;
+}
+
 int main(int argc, char ** argv)
 {
     // process argv
     char leave_stdin = 1;
     const char * prompt = "";
+    const char * history_file = NULL;
+    char use_history_file = 0;
+    char use_completion_filter = 1;
+    // can't be more of these than there are arguments
+    const char ** reject_patterns = (const char **)malloc(argc * sizeof(char *));
+    int reject_patterns_len = 0;
+    int history_max_words = 0;
+    size_t history_max_bytes = 0;
+    int max_redraw_hz = 0;
+    size_t output_buffer_limit = 0x100000;
+    char use_threads = 0;
+    char use_passthrough = 1;
+    char use_scroll_region = 0;
+    enum consoline_overflow_policy overflow_policy = CONSOLINE_OVERFLOW_BLOCK;
     int i;
     for (i = 1; i < argc; i++) {
         char * arg = argv[i];
@@ -224,19 +1001,84 @@ int main(int argc, char ** argv)
             handle_ctrl_c = 0;
         else if (strcmp(arg, "--no-completion") == 0)
             use_completion = 0;
+        else if (strcmp(arg, "--no-completion-filter") == 0)
+            use_completion_filter = 0;
+        else if (strncmp(arg, "--completion-reject=", strlen("--completion-reject=")) == 0)
+            reject_patterns[reject_patterns_len++] = arg + strlen("--completion-reject=");
+        else if (strcmp(arg, "--history-file") == 0)
+            use_history_file = 1;
+        else if (strncmp(arg, "--history-file=", strlen("--history-file=")) == 0) {
+            use_history_file = 1;
+            history_file = arg + strlen("--history-file=");
+        }
+        else if (strcmp(arg, "--no-history-file") == 0)
+            use_history_file = 0;
+        else if (strncmp(arg, "--history-max-words=", strlen("--history-max-words=")) == 0)
+            history_max_words = parse_count(arg + strlen("--history-max-words="));
+        else if (strncmp(arg, "--history-max-bytes=", strlen("--history-max-bytes=")) == 0)
+            history_max_bytes = parse_size(arg + strlen("--history-max-bytes="));
         else if (strcmp(arg, "--hide-entered-lines") == 0)
             leave_stdin = 0;
         else if (strncmp(arg, "--prompt=", strlen("--prompt=")) == 0)
             prompt = arg + strlen("--prompt=");
+        else if (strncmp(arg, "--max-redraw-hz=", strlen("--max-redraw-hz=")) == 0)
+            max_redraw_hz = atoi(arg + strlen("--max-redraw-hz="));
+        else if (strcmp(arg, "--scroll-region") == 0)
+            use_scroll_region = 1;
+        else if (strcmp(arg, "--no-passthrough") == 0)
+            use_passthrough = 0;
+        else if (strcmp(arg, "--separate-stderr") == 0)
+            separate_stderr = 1;
+        else if (strcmp(arg, "--stderr-color") == 0)
+            separate_stderr = color_stderr = 1;
+        else if (strcmp(arg, "--pty") == 0)
+            use_pty = 1;
+        else if (strcmp(arg, "--threads") == 0)
+            use_threads = 1;
+        else if (strncmp(arg, "--output-buffer=", strlen("--output-buffer=")) == 0)
+            output_buffer_limit = parse_size(arg + strlen("--output-buffer="));
+        else if (strcmp(arg, "--overflow=block") == 0)
+            overflow_policy = CONSOLINE_OVERFLOW_BLOCK;
+        else if (strcmp(arg, "--overflow=drop-oldest") == 0)
+            overflow_policy = CONSOLINE_OVERFLOW_DROP_OLDEST;
+        else if (strcmp(arg, "--overflow=drop-newest") == 0)
+            overflow_policy = CONSOLINE_OVERFLOW_DROP_NEWEST;
         else {
             fprintf(stderr, "unrecognized option: %s\n\n", arg);
             print_usage_and_exit();
         }
     }
+    // there's no point in an input line without a terminal to show it on.
+    // stdin not being a terminal (cmd < file) still gets an input line, so the output options keep working.
+    char passthrough = use_passthrough && !isatty(STDOUT_FILENO);
+    if (passthrough) {
+        use_completion = 0;
+        // there's no input line for ctrl+c to clear, so the child shouldn't ignore it
+        handle_ctrl_c = 0;
+        warn_about_line_editing_options(argv + 1, i - 1);
+    }
     if (use_completion) {
-        history_database = HistoryDatabase_create(0);
-        init_seperator_chars();
+        if (use_history_file)
+            open_history_database(history_file);
+        else
+            history_database = HistoryDatabase_create(0);
+        HistoryDatabase_set_max_words(history_database, history_max_words);
+        HistoryDatabase_set_max_bytes(history_database, history_max_bytes);
+        char * separators = consoline_get_completion_separators();
+        tokenizer = Tokenizer_create(separators);
+        free(separators);
+        if (use_completion_filter) {
+            admission_filter = AdmissionFilter_create();
+            int j;
+            for (j = 0; j < reject_patterns_len; j++) {
+                if (!AdmissionFilter_add_reject_pattern(admission_filter, reject_patterns[j])) {
+                    fprintf(stderr, "invalid regular expression: %s\n", reject_patterns[j]);
+                    exit(1);
+                }
+            }
+        }
     }
+    free(reject_patterns);
     int child_argv_start = i;
     int child_argv_size = argc - child_argv_start + 1;
     if (child_argv_size <= 1)
@@ -247,26 +1089,48 @@ int main(int argc, char ** argv)
         child_argv[i] = argv[i + child_argv_start];
     child_argv[i] = NULL;
 
-    consoline_init("consoline", prompt);
+    report_stats_on_sigusr1();
+    if (passthrough)
+        relay_without_line_editing(child_argv);
+
+    consoline_init(PROFILE_NAME, prompt);
+    line_editing = 1;
     atexit(consoline_deinit);
+    if (use_completion) {
+        indexer = Indexer_create(history_database, tokenizer, admission_filter);
+        atexit(close_history_database);
+    }
     consoline_set_eof_handler(eof_handler);
     consoline_set_line_handler(line_handler);
     consoline_set_ctrl_c_handled(handle_ctrl_c);
     if (use_completion)
         consoline_set_completion_handler(completion_handler);
     consoline_set_leave_entered_lines_on_stdout(leave_stdin);
+    consoline_set_max_redraw_hz(max_redraw_hz);
+    // terminals that can't do it get the usual redrawing
+    if (use_scroll_region)
+        consoline_set_scroll_region(1);
+    consoline_set_output_buffer_limit(output_buffer_limit, overflow_policy);
 
-    launch_child_process(child_argv);
+    launch_child_process(child_argv, use_threads, separate_stderr);
+    fcntl(child_stdin_fd, F_SETFL, fcntl(child_stdin_fd, F_GETFL) | O_NONBLOCK);
+    // after consoline has set up its handler
+    if (child_pty_fd != -1)
+        forward_window_size_changes();
+    if (child_pty_fd != -1 && !handle_ctrl_c)
+        forward_ctrl_c();
+    block_signals_outside_of_waiting();
 
     for (;;) {
-        consoline_poll();
+        if (child_pty_fd != -1)
+            forward_window_size_if_changed();
+        if (stats_requested)
+            print_stats();
         poll_subprocess();
-
-        // poll input at 60 Hz or whatever
-        struct timespec requested;
-        memset(&requested, 0, sizeof(requested));
-        requested.tv_nsec = 1000000000 / 60;
-        nanosleep(&requested, NULL);
+        if (wait_for_events())
+            consoline_on_readable();
+        if (child_stdin_queue_size() > 0)
+            flush_child_stdin_queue();
     }
 }
 
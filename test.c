@@ -6,6 +6,7 @@
 #include "consoline.h"
 
 #include <unistd.h>
+#include <poll.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
@@ -101,17 +102,27 @@ int main()
     consoline_set_completion_handler(completion_handler);
     consoline_set_ctrl_c_handled(1);
 
+    // print something every second, and otherwise sleep until consoline has something to do
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long long next_print_time = now.tv_sec * 1000LL + now.tv_nsec / 1000000 + 1000;
     int i;
-    for (i = 0;; i++) {
-        if (printing && i % 60 == 0)
-            consoline_printfln("async %d", i / 60);
-        consoline_poll();
-
-        // poll input at 60 Hz or whatever
-        struct timespec requested;
-        memset(&requested, 0, sizeof(requested));
-        requested.tv_nsec = 1000000000 / 60;
-        nanosleep(&requested, NULL);
+    for (i = 0;;) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long long timeout = next_print_time - (now.tv_sec * 1000LL + now.tv_nsec / 1000000);
+        if (timeout <= 0) {
+            if (printing)
+                consoline_printfln("async %d", i);
+            i++;
+            next_print_time += 1000;
+            continue;
+        }
+        struct pollfd consoline_fd;
+        consoline_fd.fd = consoline_get_fd();
+        consoline_fd.events = POLLIN;
+        // an interrupted poll() might have been ctrl+c
+        if (poll(&consoline_fd, 1, timeout) != 0)
+            consoline_on_readable();
     }
     return 0;
 }